@@ -0,0 +1,455 @@
+#pragma once
+
+#include "./coroutine_support.h"
+#include <optional>
+#include <utility>
+#include <stdint.h>
+#include "./coroutine_sync.h"
+
+namespace silk {
+    namespace demo_coroutines {
+        template<typename T> struct channel_waiter {
+        	channel_waiter* next = nullptr;
+        	silk::task* frame = nullptr;
+        	T* value = nullptr;
+        	bool is_done = false;
+        };
+        
+        template<typename T> class channel;
+        
+        // A send or receive that completes at once spends budget of the coroutine (is_budget_spent);
+        // once it is spent the coroutine is requeued behind the other tasks of the worker anyway.
+        template<typename T> struct channel_send_awaitable {
+        	channel<T>& ch;
+        	T value;
+        	channel_waiter<T> waiter = {};
+        	bool is_yielding = false;
+        
+        	bool await_ready() { return ch.try_send_fast(value, waiter) && !(is_yielding = is_budget_spent()); }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		waiter.frame = frame_of(coro);
+        
+        		if (is_yielding) {
+        			requeue(waiter.frame);
+        
+        			return true;
+        		}
+        
+        		return ch.suspend_sender(waiter);
+        	}
+        
+        	// false when the channel was closed and the value was not sent
+        	bool await_resume() noexcept { return waiter.is_done; }
+        };
+        
+        template<typename T> struct channel_recv_awaitable {
+        	channel<T>& ch;
+        	T value = T();
+        	channel_waiter<T> waiter = {};
+        	bool is_yielding = false;
+        
+        	bool await_ready() { return ch.try_recv_fast(value, waiter) && !(is_yielding = is_budget_spent()); }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		waiter.frame = frame_of(coro);
+        
+        		if (is_yielding) {
+        			requeue(waiter.frame);
+        
+        			return true;
+        		}
+        
+        		return ch.suspend_receiver(waiter);
+        	}
+        
+        	// empty when the channel is closed and drained
+        	std::optional<T> await_resume() {
+        		if (!waiter.is_done)
+        			return std::nullopt;
+        
+        		return std::optional<T>(std::move(value));
+        	}
+        };
+        
+        template<typename T, typename OutputIterator> struct channel_recv_batch_awaitable {
+        	channel_recv_awaitable<T> first;
+        	OutputIterator out;
+        	size_t max_count;
+        
+        	// a batch of 0 receives nothing and does not wait
+        	bool await_ready() { return max_count == 0 || first.await_ready(); }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		return first.await_suspend(coro);
+        	}
+        
+        	// number of values written to out, 0 when the channel is closed and drained
+        	size_t await_resume() {
+        		if (max_count == 0 || !first.waiter.is_done)
+        			return 0;
+        
+        		*out++ = std::move(first.value);
+        
+        		return 1 + first.ch.try_recv_many(out, max_count - 1);
+        	}
+        };
+        
+        //---------------------------------------------------------
+        // Bounded MPMC channel for coroutines. Values go through a lock-free
+        // ring (sequence number per cell); the spin lock is only taken when
+        // the ring is full or empty, to queue the coroutine, and by the
+        // other side when somebody is queued. A queued coroutine gets its
+        // value handed over (or its value taken) by the coroutine that
+        // unblocks it, and is resumed on that coroutine's worker.
+        //---------------------------------------------------------
+        template<typename T> class channel {
+        	struct cell {
+        		std::atomic<size_t> sequence;
+        		T value;
+        	};
+        
+        	cell* cells_;
+        	size_t mask_;
+        	alignas(64) std::atomic<size_t> send_pos_;
+        	alignas(64) std::atomic<size_t> recv_pos_;
+        	alignas(64) std::atomic<int> waiting_senders_count_;
+        	std::atomic<int> waiting_receivers_count_;
+        	std::atomic<bool> is_closed_;
+        	silk::spin_lock sync_;
+        	channel_waiter<T>* senders_head_ = nullptr;
+        	channel_waiter<T>* senders_tail_ = nullptr;
+        	channel_waiter<T>* receivers_head_ = nullptr;
+        	channel_waiter<T>* receivers_tail_ = nullptr;
+        
+        	template<typename> friend struct channel_send_awaitable;
+        	template<typename> friend struct channel_recv_awaitable;
+        	template<typename, typename> friend struct channel_recv_batch_awaitable;
+        
+        	static void push_back(channel_waiter<T>*& head, channel_waiter<T>*& tail, channel_waiter<T>& w) {
+        		w.next = nullptr;
+        
+        		if (tail) {
+        			tail->next = &w;
+        		} else {
+        			head = &w;
+        		}
+        
+        		tail = &w;
+        	}
+        
+        	static channel_waiter<T>* pop_front(channel_waiter<T>*& head, channel_waiter<T>*& tail) {
+        		channel_waiter<T>* w = head;
+        
+        		head = w->next;
+        
+        		if (!head) {
+        			tail = nullptr;
+        		}
+        
+        		return w;
+        	}
+        
+        	bool try_push(T& v) {
+        		size_t pos = send_pos_.load(std::memory_order_relaxed);
+        
+        		while (1) {
+        			cell& c = cells_[pos & mask_];
+        			const intptr_t diff = (intptr_t) c.sequence.load(std::memory_order_acquire) - (intptr_t) pos;
+        
+        			if (diff == 0) {
+        				if (send_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        					c.value = std::move(v);
+        					c.sequence.store(pos + 1, std::memory_order_release);
+        
+        					return true;
+        				}
+        			} else if (diff < 0) {
+        				return false;
+        			} else {
+        				pos = send_pos_.load(std::memory_order_relaxed);
+        			}
+        		}
+        	}
+        
+        	bool try_pop(T& v) {
+        		size_t pos = recv_pos_.load(std::memory_order_relaxed);
+        
+        		while (1) {
+        			cell& c = cells_[pos & mask_];
+        			const intptr_t diff = (intptr_t) c.sequence.load(std::memory_order_acquire) - (intptr_t) (pos + 1);
+        
+        			if (diff == 0) {
+        				if (recv_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        					v = std::move(c.value);
+        					c.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        
+        					return true;
+        				}
+        			} else if (diff < 0) {
+        				return false;
+        			} else {
+        				pos = recv_pos_.load(std::memory_order_relaxed);
+        			}
+        		}
+        	}
+        
+        	// A value was pushed: queued receivers take values while there are any.
+        	void notify_receivers() {
+        		std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        		while (waiting_receivers_count_.load(std::memory_order_relaxed) > 0) {
+        			sync_.lock();
+        
+        			channel_waiter<T>* w = receivers_head_;
+        
+        			if (!w || !try_pop(*w->value)) {
+        				sync_.unlock();
+        
+        				return;
+        			}
+        
+        			pop_front(receivers_head_, receivers_tail_);
+        			waiting_receivers_count_.fetch_sub(1, std::memory_order_relaxed);
+        
+        			sync_.unlock();
+        
+        			w->is_done = true;
+        			wake(w->frame);
+        
+        			// the pop above made room for a queued sender
+        			notify_senders();
+        		}
+        	}
+        
+        	// A value was popped: queued senders put their values while there is room.
+        	void notify_senders() {
+        		std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        		while (waiting_senders_count_.load(std::memory_order_relaxed) > 0) {
+        			sync_.lock();
+        
+        			channel_waiter<T>* w = senders_head_;
+        
+        			if (!w || !try_push(*w->value)) {
+        				sync_.unlock();
+        
+        				return;
+        			}
+        
+        			pop_front(senders_head_, senders_tail_);
+        			waiting_senders_count_.fetch_sub(1, std::memory_order_relaxed);
+        
+        			sync_.unlock();
+        
+        			w->is_done = true;
+        			wake(w->frame);
+        
+        			notify_receivers();
+        		}
+        	}
+        
+        	bool try_send_fast(T& v, channel_waiter<T>& w) {
+        		w.value = &v;
+        
+        		if (is_closed_.load(std::memory_order_acquire)) {
+        			w.is_done = false;
+        
+        			return true;
+        		}
+        
+        		if (!try_push(v))
+        			return false;
+        
+        		w.is_done = true;
+        
+        		notify_receivers();
+        
+        		return true;
+        	}
+        
+        	bool try_recv_fast(T& v, channel_waiter<T>& w) {
+        		w.value = &v;
+        
+        		if (!try_pop(v))
+        			return false;
+        
+        		w.is_done = true;
+        
+        		notify_senders();
+        
+        		return true;
+        	}
+        
+        	// returns false when the send completed (or failed) without suspending
+        	bool suspend_sender(channel_waiter<T>& w) {
+        		sync_.lock();
+        
+        		waiting_senders_count_.fetch_add(1, std::memory_order_seq_cst);
+        		std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        		const bool is_closed = is_closed_.load(std::memory_order_acquire);
+        
+        		if (is_closed || try_push(*w.value)) {
+        			waiting_senders_count_.fetch_sub(1, std::memory_order_relaxed);
+        
+        			sync_.unlock();
+        
+        			w.is_done = !is_closed;
+        
+        			if (!is_closed) {
+        				notify_receivers();
+        			}
+        
+        			return false;
+        		}
+        
+        		push_back(senders_head_, senders_tail_, w);
+        
+        		sync_.unlock();
+        
+        		return true;
+        	}
+        
+        	bool suspend_receiver(channel_waiter<T>& w) {
+        		sync_.lock();
+        
+        		waiting_receivers_count_.fetch_add(1, std::memory_order_seq_cst);
+        		std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        		const bool is_received = try_pop(*w.value);
+        
+        		if (is_received || is_closed_.load(std::memory_order_acquire)) {
+        			waiting_receivers_count_.fetch_sub(1, std::memory_order_relaxed);
+        
+        			sync_.unlock();
+        
+        			w.is_done = is_received;
+        
+        			if (is_received) {
+        				notify_senders();
+        			}
+        
+        			return false;
+        		}
+        
+        		push_back(receivers_head_, receivers_tail_, w);
+        
+        		sync_.unlock();
+        
+        		return true;
+        	}
+        public:
+        	// capacity is rounded up to a power of two; T has to be default constructible and movable
+        	channel(const size_t capacity) {
+        		size_t size = 2;
+        
+        		while (size < capacity) {
+        			size <<= 1;
+        		}
+        
+        		cells_ = new cell[size];
+        		mask_ = size - 1;
+        
+        		for (size_t i = 0; i < size; i++) {
+        			cells_[i].sequence.store(i, std::memory_order_relaxed);
+        		}
+        
+        		send_pos_.store(0, std::memory_order_relaxed);
+        		recv_pos_.store(0, std::memory_order_relaxed);
+        		waiting_senders_count_.store(0, std::memory_order_relaxed);
+        		waiting_receivers_count_.store(0, std::memory_order_relaxed);
+        		is_closed_.store(false, std::memory_order_release);
+        	}
+        
+        	channel(const channel&) = delete;
+        
+        	~channel() {
+        		delete[] cells_;
+        	}
+        
+        	// co_await send(v) returns false when the channel is closed
+        	channel_send_awaitable<T> send(T v) {
+        		return channel_send_awaitable<T>{ *this, std::move(v) };
+        	}
+        
+        	// co_await recv() returns an empty optional when the channel is closed and drained
+        	channel_recv_awaitable<T> recv() {
+        		return channel_recv_awaitable<T>{ *this };
+        	}
+        
+        	// co_await recv_batch(out, n) waits for one value, then takes up to n - 1 more that are ready (0 for n == 0)
+        	template<typename OutputIterator> channel_recv_batch_awaitable<T, OutputIterator> recv_batch(OutputIterator out, const size_t max_count) {
+        		return channel_recv_batch_awaitable<T, OutputIterator>{ channel_recv_awaitable<T>{ *this }, out, max_count };
+        	}
+        
+        	bool try_send(T v) {
+        		if (is_closed_.load(std::memory_order_acquire) || !try_push(v))
+        			return false;
+        
+        		notify_receivers();
+        
+        		return true;
+        	}
+        
+        	bool try_recv(T& v) {
+        		if (!try_pop(v))
+        			return false;
+        
+        		notify_senders();
+        
+        		return true;
+        	}
+        
+        	template<typename OutputIterator> size_t try_recv_many(OutputIterator& out, const size_t max_count) {
+        		size_t n = 0;
+        		T v;
+        
+        		while (n < max_count && try_pop(v)) {
+        			*out++ = std::move(v);
+        			n++;
+        		}
+        
+        		if (n) {
+        			notify_senders();
+        		}
+        
+        		return n;
+        	}
+        
+        	// Wakes every queued coroutine: senders get false, receivers drain what is left and then get nothing.
+        	void close() {
+        		sync_.lock();
+        
+        		is_closed_.store(true, std::memory_order_release);
+        
+        		channel_waiter<T>* senders = senders_head_;
+        		channel_waiter<T>* receivers = receivers_head_;
+        
+        		senders_head_ = senders_tail_ = receivers_head_ = receivers_tail_ = nullptr;
+        		waiting_senders_count_.store(0, std::memory_order_relaxed);
+        		waiting_receivers_count_.store(0, std::memory_order_relaxed);
+        
+        		sync_.unlock();
+        
+        		while (senders) {
+        			channel_waiter<T>* w = senders;
+        			senders = w->next;
+        			w->is_done = false;
+        			wake(w->frame);
+        		}
+        
+        		while (receivers) {
+        			channel_waiter<T>* w = receivers;
+        			receivers = w->next;
+        			w->is_done = try_pop(*w->value);
+        			wake(w->frame);
+        		}
+        	}
+        
+        	bool is_closed() const {
+        		return is_closed_.load(std::memory_order_acquire);
+        	}
+        };
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// C++20 <coroutine> when the compiler implements it, the Coroutines TS header otherwise.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+
+namespace silk {
+    namespace coro {
+        using std::coroutine_handle;
+        using std::noop_coroutine;
+        using std::suspend_always;
+        using std::suspend_never;
+    }
+}
+#else
+#include <experimental/coroutine>
+
+namespace silk {
+    namespace coro {
+        using std::experimental::coroutine_handle;
+        using std::experimental::noop_coroutine;
+        using std::experimental::suspend_always;
+        using std::experimental::suspend_never;
+    }
+}
+#endif
@@ -0,0 +1,401 @@
+#pragma once
+
+#include "./coroutine_support.h"
+#include "./../src/silk_pool.h"
+
+namespace silk {
+    namespace demo_coroutines {
+        // A suspended coroutine of taskruntime4.x: its frame is the silk::task that resumes it.
+        template<typename P> silk::task* frame_of(silk::coro::coroutine_handle<P> coro) {
+        	return (silk::task*) &coro.promise().frame_;
+        }
+        
+        // Resumes a suspended coroutine on the current worker, right after the running task (run-next slot).
+        // A thread outside the pool loops (an event loop) never drains its slot, so there it is an ordinary spawn.
+        inline void wake(silk::task* frame) {
+        	if (silk::is_in_pool_loop) {
+        		silk::spawn_next(silk::current_worker_id, frame);
+        	} else {
+        		silk::spawn(silk::current_worker_id, frame);
+        	}
+        }
+        
+        // Spends a unit of the budget of the running coroutine (silk::spend_budget) for an operation that
+        // completed without suspending; true when the coroutine has to give way with requeue(). Not counted
+        // outside the pool loops, where schedule does not refill the budget (an event loop thread).
+        inline bool is_budget_spent() {
+        	return silk::is_in_pool_loop && silk::spend_budget(silk::current_worker_id);
+        }
+        
+        // Suspended coroutine goes to the FIFO end of the deque of the current worker.
+        inline void requeue(silk::task* frame) {
+        	silk::spawn_fifo(silk::current_worker_id, frame);
+        }
+        
+        // Waiting coroutine, lives in its awaitable (so in the coroutine frame).
+        struct sync_waiter {
+        	sync_waiter* next = nullptr;
+        	silk::task* frame = nullptr;
+        };
+        
+        // FIFO of waiters, guarded by the owner's lock.
+        struct sync_waiters {
+        	sync_waiter* head = nullptr;
+        	sync_waiter* tail = nullptr;
+        
+        	bool empty() const {
+        		return !head;
+        	}
+        
+        	void push_back(sync_waiter& w) {
+        		w.next = nullptr;
+        
+        		if (tail) {
+        			tail->next = &w;
+        		} else {
+        			head = &w;
+        		}
+        
+        		tail = &w;
+        	}
+        
+        	sync_waiter* pop_front() {
+        		sync_waiter* w = head;
+        
+        		head = w->next;
+        
+        		if (!head) {
+        			tail = nullptr;
+        		}
+        
+        		return w;
+        	}
+        
+        	// detaches every waiter, wake_all() them after the lock is released
+        	sync_waiter* take_all() {
+        		sync_waiter* w = head;
+        		head = tail = nullptr;
+        		return w;
+        	}
+        
+        	static void wake_all(sync_waiter* w) {
+        		while (w) {
+        			sync_waiter* next = w->next;
+        			wake(w->frame);
+        			w = next;
+        		}
+        	}
+        };
+        
+        //---------------------------------------------------------
+        // Primitives below suspend the coroutine instead of the worker
+        // thread. The fast path is one atomic operation; the spin lock is
+        // only taken to queue a waiter and to release to one. Release hands
+        // ownership (the mutex, a permit) straight to the first waiter, so a
+        // woken coroutine never has to compete for it again.
+        //---------------------------------------------------------
+        class async_mutex;
+        
+        class async_mutex_lock {
+        	async_mutex* mutex_;
+        public:
+        	explicit async_mutex_lock(async_mutex& m) : mutex_(&m) {
+        	}
+        
+        	async_mutex_lock(async_mutex_lock&& l) noexcept : mutex_(l.mutex_) {
+        		l.mutex_ = nullptr;
+        	}
+        
+        	~async_mutex_lock();
+        };
+        
+        class async_mutex {
+        	std::atomic<bool> is_locked_;
+        	silk::spin_lock sync_;
+        	sync_waiters waiters_;
+        
+        	bool lock_or_enqueue(sync_waiter& w) {
+        		sync_.lock();
+        
+        		const bool is_locked = try_lock();
+        
+        		if (!is_locked) {
+        			waiters_.push_back(w);
+        		}
+        
+        		sync_.unlock();
+        
+        		return is_locked;
+        	}
+        public:
+        	struct lock_awaitable {
+        		async_mutex& m;
+        		sync_waiter waiter = {};
+        
+        		bool await_ready() noexcept { return m.try_lock(); }
+        
+        		template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        			waiter.frame = frame_of(coro);
+        			return !m.lock_or_enqueue(waiter);
+        		}
+        
+        		void await_resume() noexcept {}
+        	};
+        
+        	struct scoped_lock_awaitable : public lock_awaitable {
+        		async_mutex_lock await_resume() noexcept { return async_mutex_lock(this->m); }
+        	};
+        
+        	async_mutex() : is_locked_(false) {
+        	}
+        
+        	async_mutex(const async_mutex&) = delete;
+        
+        	bool try_lock() {
+        		bool expected = false;
+        		return is_locked_.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed);
+        	}
+        
+        	// co_await lock()
+        	lock_awaitable lock() {
+        		return lock_awaitable{ *this };
+        	}
+        
+        	// auto guard = co_await scoped_lock(); unlocks when the guard goes out of scope
+        	scoped_lock_awaitable scoped_lock() {
+        		return scoped_lock_awaitable{ { *this } };
+        	}
+        
+        	void unlock() {
+        		sync_.lock();
+        
+        		sync_waiter* next = waiters_.empty() ? nullptr : waiters_.pop_front();
+        
+        		if (!next) {
+        			is_locked_.store(false, std::memory_order_release);
+        		}
+        
+        		sync_.unlock();
+        
+        		if (next) {
+        			// still locked, now on behalf of next
+        			wake(next->frame);
+        		}
+        	}
+        };
+        
+        inline async_mutex_lock::~async_mutex_lock() {
+        	if (mutex_) {
+        		mutex_->unlock();
+        	}
+        }
+        
+        class async_semaphore {
+        	std::atomic<int> count_;
+        	silk::spin_lock sync_;
+        	sync_waiters waiters_;
+        
+        	bool acquire_or_enqueue(sync_waiter& w) {
+        		sync_.lock();
+        
+        		const bool is_acquired = try_acquire();
+        
+        		if (!is_acquired) {
+        			waiters_.push_back(w);
+        		}
+        
+        		sync_.unlock();
+        
+        		return is_acquired;
+        	}
+        public:
+        	struct acquire_awaitable {
+        		async_semaphore& s;
+        		sync_waiter waiter = {};
+        
+        		bool await_ready() noexcept { return s.try_acquire(); }
+        
+        		template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        			waiter.frame = frame_of(coro);
+        			return !s.acquire_or_enqueue(waiter);
+        		}
+        
+        		void await_resume() noexcept {}
+        	};
+        
+        	explicit async_semaphore(const int count) : count_(count) {
+        	}
+        
+        	async_semaphore(const async_semaphore&) = delete;
+        
+        	bool try_acquire() {
+        		int c = count_.load(std::memory_order_relaxed);
+        
+        		while (c > 0) {
+        			if (count_.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+        				return true;
+        		}
+        
+        		return false;
+        	}
+        
+        	// co_await acquire()
+        	acquire_awaitable acquire() {
+        		return acquire_awaitable{ *this };
+        	}
+        
+        	// permits go to waiters first, in arrival order, the rest back to the count
+        	void release(int n = 1) {
+        		sync_waiters woken;
+        
+        		sync_.lock();
+        
+        		while (n > 0 && !waiters_.empty()) {
+        			woken.push_back(*waiters_.pop_front());
+        			n--;
+        		}
+        
+        		if (n > 0) {
+        			count_.fetch_add(n, std::memory_order_release);
+        		}
+        
+        		sync_.unlock();
+        
+        		sync_waiters::wake_all(woken.take_all());
+        	}
+        
+        	int available() const {
+        		return count_.load(std::memory_order_relaxed);
+        	}
+        };
+        
+        // Single use: wait() resumes once count_down() has been called count times.
+        class async_latch {
+        	std::atomic<int> count_;
+        	silk::spin_lock sync_;
+        	sync_waiters waiters_;
+        
+        	bool wait_or_enqueue(sync_waiter& w) {
+        		sync_.lock();
+        
+        		const bool is_ready = try_wait();
+        
+        		if (!is_ready) {
+        			waiters_.push_back(w);
+        		}
+        
+        		sync_.unlock();
+        
+        		return is_ready;
+        	}
+        public:
+        	struct wait_awaitable {
+        		async_latch& l;
+        		sync_waiter waiter = {};
+        
+        		bool await_ready() noexcept { return l.try_wait(); }
+        
+        		template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        			waiter.frame = frame_of(coro);
+        			return !l.wait_or_enqueue(waiter);
+        		}
+        
+        		void await_resume() noexcept {}
+        	};
+        
+        	explicit async_latch(const int count) : count_(count) {
+        	}
+        
+        	async_latch(const async_latch&) = delete;
+        
+        	bool try_wait() const {
+        		return count_.load(std::memory_order_acquire) <= 0;
+        	}
+        
+        	void count_down(const int n = 1) {
+        		if (count_.fetch_sub(n, std::memory_order_acq_rel) - n > 0)
+        			return;
+        
+        		sync_.lock();
+        		sync_waiter* woken = waiters_.take_all();
+        		sync_.unlock();
+        
+        		sync_waiters::wake_all(woken);
+        	}
+        
+        	// co_await wait()
+        	wait_awaitable wait() {
+        		return wait_awaitable{ *this };
+        	}
+        
+        	// co_await arrive_and_wait() counts down by one and waits for the others
+        	wait_awaitable arrive_and_wait() {
+        		count_down();
+        		return wait_awaitable{ *this };
+        	}
+        };
+        
+        // Reusable: every phase completes when count coroutines have arrived; the last one continues without suspending.
+        class async_barrier {
+        	const int count_;
+        	int arrived_ = 0;
+        	int phase_ = 0;
+        	silk::spin_lock sync_;
+        	sync_waiters waiters_;
+        
+        	bool arrive_or_enqueue(sync_waiter& w) {
+        		sync_.lock();
+        
+        		if (++arrived_ < count_) {
+        			waiters_.push_back(w);
+        
+        			sync_.unlock();
+        
+        			return false;
+        		}
+        
+        		arrived_ = 0;
+        		phase_++;
+        
+        		sync_waiter* woken = waiters_.take_all();
+        
+        		sync_.unlock();
+        
+        		sync_waiters::wake_all(woken);
+        
+        		return true;
+        	}
+        public:
+        	struct arrive_awaitable {
+        		async_barrier& b;
+        		sync_waiter waiter = {};
+        
+        		bool await_ready() noexcept { return false; }
+        
+        		template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        			waiter.frame = frame_of(coro);
+        			return !b.arrive_or_enqueue(waiter);
+        		}
+        
+        		void await_resume() noexcept {}
+        	};
+        
+        	explicit async_barrier(const int count) : count_(count) {
+        	}
+        
+        	async_barrier(const async_barrier&) = delete;
+        
+        	// co_await arrive_and_wait()
+        	arrive_awaitable arrive_and_wait() {
+        		return arrive_awaitable{ *this };
+        	}
+        
+        	int phase() {
+        		sync_.lock();
+        		const int p = phase_;
+        		sync_.unlock();
+        		return p;
+        	}
+        };
+    }
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <memory>
 #include "taskruntime1.h"
 
 void c() {
@@ -20,6 +21,12 @@ int main() {
 		silk::demo_runtime_1::spawn2( c1( i ) );
 	}
 
+	for (int i = 0; i < 30000; i++) {
+		std::unique_ptr<int> v(new int(i));
+
+		silk::demo_runtime_1::spawn( [v = std::move(v)]() { c1( *v ); } );
+	}
+
 	silk::join_main_thread_2_pool(silk::demo_runtime_1::schedule);
 
 	return 0;
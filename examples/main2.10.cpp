@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cmath>
+#include "task_group.h"
+
+const int requests = 200;
+const int parts = 16;
+const int background_tasks = 40;
+
+std::atomic<int> pending_tasks;
+std::atomic<long> total_wait_us;
+std::atomic<long> max_wait_us;
+
+double work(const int amount) {
+	double x = 0;
+
+	for (int i = 1; i <= amount; i++) {
+		x += std::sqrt((double)i) * std::sin((double)i);
+	}
+
+	return x;
+}
+
+// Unrelated long job sharing the pool with the requests.
+struct BackgroundTask : public silk::demo_runtime_2::task {
+	task* execute() override {
+		work(4000000);
+
+		pending_tasks.fetch_sub(1, std::memory_order_release);
+
+		return nullptr;
+	}
+};
+
+// Request handler with nested parallelism: splits its work over a task_group and waits for it.
+struct RequestTask : public silk::demo_runtime_2::task {
+	bool isolated;
+	RequestTask(bool isolated_) : isolated(isolated_) {
+	}
+	task* execute() override {
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		double results[parts];
+
+		silk::demo_runtime_2::task_group g;
+
+		for (int p = 0; p < parts; p++) {
+			g.run([&results, p]() { results[p] = work(20000); });
+		}
+
+		g.wait(isolated);
+
+		const long us = (long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+		total_wait_us.fetch_add(us, std::memory_order_relaxed);
+
+		long m = max_wait_us.load(std::memory_order_relaxed);
+
+		while (us > m && !max_wait_us.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+		}
+
+		pending_tasks.fetch_sub(1, std::memory_order_release);
+
+		return nullptr;
+	}
+};
+
+long serve(const bool isolated) {
+	total_wait_us.store(0);
+	max_wait_us.store(0);
+	pending_tasks.store(requests + background_tasks);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	for (int r = 0, b = 0; r < requests || b < background_tasks; r++) {
+		if (r < requests) {
+			silk::demo_runtime_2::spawn(*new RequestTask(isolated));
+		}
+
+		if (b < background_tasks && r % (requests / background_tasks) == 0) {
+			silk::demo_runtime_2::spawn(*new BackgroundTask());
+			b++;
+		}
+	}
+
+	silk::demo_runtime_2::wait_while([]() { return pending_tasks.load(std::memory_order_acquire) > 0; });
+
+	return (long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::cout << requests << " requests x " << parts << " parts, " << background_tasks << " long background tasks" << std::endl;
+
+	for (bool isolated : { false, true }) {
+		const long ms = serve(isolated);
+
+		std::cout << (isolated ? "wait(true), isolated: " : "wait():               ") << ms << " ms, task_group wait avg: "
+			<< total_wait_us.load() / requests << " us, max: " << max_wait_us.load() << " us" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+#define SILK_QUEUE_STATS
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "taskruntime2.h"
+
+const int completions = 2000;
+const int completion_interval_us = 250;
+const int burst_ms = 700;
+
+std::atomic<long> live_burst_tasks;
+std::atomic<int> completed;
+std::vector<long> latencies_us(completions);
+std::chrono::steady_clock::time_point burst_deadline;
+
+double work(const int amount) {
+	double x = 0;
+
+	for (int i = 1; i <= amount; i++) {
+		x += std::sqrt((double)i) * std::sin((double)i);
+	}
+
+	return x;
+}
+
+// Local compute burst: every task spawns two more until the deadline, so the deque of each worker never runs dry.
+struct BurstTask : public silk::demo_runtime_2::task {
+	BurstTask() {
+		live_burst_tasks.fetch_add(1, std::memory_order_relaxed);
+	}
+	~BurstTask() {
+		live_burst_tasks.fetch_sub(1, std::memory_order_relaxed);
+	}
+	task* execute() override {
+		if (std::chrono::steady_clock::now() < burst_deadline) {
+			work(5000);
+
+			silk::demo_runtime_2::spawn(*new BurstTask());
+			silk::demo_runtime_2::spawn(*new BurstTask());
+		}
+
+		return nullptr;
+	}
+};
+
+// I/O completion delivered to the affinity queue of a worker by an event loop thread.
+struct CompletionTask : public silk::demo_runtime_2::task {
+	int i;
+	std::chrono::steady_clock::time_point sent;
+	CompletionTask(int i_) : i(i_) {
+	}
+	task* execute() override {
+		latencies_us[i] = (long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent).count();
+
+		completed.fetch_add(1, std::memory_order_release);
+
+		return nullptr;
+	}
+};
+
+void run(const char* name) {
+	std::vector<CompletionTask*> tasks;
+
+	for (int i = 0; i < completions; i++) {
+		tasks.push_back(new CompletionTask(i));
+	}
+
+	completed.store(0);
+	silk::reset_queue_stats();
+
+	burst_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(burst_ms);
+
+	for (int w = 0; w < silk::workers_count; w++) {
+		silk::demo_runtime_2::spawn(*new BurstTask());
+	}
+
+	std::thread event_loop([&tasks]() {
+		for (int i = 0; i < completions; i++) {
+			std::this_thread::sleep_for(std::chrono::microseconds(completion_interval_us));
+
+			tasks[i]->sent = std::chrono::steady_clock::now();
+
+			silk::enqueue_affinity(i % silk::workers_count, tasks[i]);
+		}
+	});
+
+	silk::demo_runtime_2::wait_while([]() {
+		return completed.load(std::memory_order_acquire) < completions || live_burst_tasks.load(std::memory_order_relaxed) > 0;
+	});
+
+	event_loop.join();
+
+	std::vector<long> sorted = latencies_us;
+	std::sort(sorted.begin(), sorted.end());
+
+	std::cout << name << " completion latency p50: " << sorted[completions / 2] << " us, p99.9: " << sorted[completions * 999 / 1000]
+		<< " us, max: " << sorted.back() << " us | max residency affinity queue: " << silk::max_queue_residency(silk::affinity_queue) / 1000
+		<< " us, deque: " << silk::max_queue_residency(silk::deque_queue) / 1000 << " us" << std::endl;
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::cout << completions << " I/O completions every " << completion_interval_us << " us during a " << burst_ms << " ms compute burst" << std::endl;
+
+	silk::set_fairness(0, 0);
+	run("no fair polling:            ");
+
+	silk::set_fairness(61, 0);
+	run("fair poll every 61 tasks:   ");
+
+	silk::set_fairness(0, 500);
+	run("fair poll every 500 us:     ");
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "taskruntime2.h"
+
+const int requests = 4000;
+const int request_work = 60000;
+const int min_sla_ms = 5;
+const int max_sla_ms = 600;
+
+std::atomic<int> completed;
+std::atomic<int> late;
+
+double work(const int amount) {
+	double x = 0;
+
+	for (int i = 1; i <= amount; i++) {
+		x += std::sqrt((double)i) * std::sin((double)i);
+	}
+
+	return x;
+}
+
+// Request that has to be answered within its SLA.
+struct RequestTask : public silk::demo_runtime_2::task {
+	std::chrono::steady_clock::time_point deadline;
+	task* execute() override {
+		work(request_work);
+
+		if (std::chrono::steady_clock::now() > deadline) {
+			late.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		completed.fetch_add(1, std::memory_order_release);
+
+		return nullptr;
+	}
+};
+
+void serve(const bool is_deadline_mode) {
+	silk::set_deadline_mode(is_deadline_mode);
+	silk::reset_deadline_stats();
+
+	completed.store(0);
+	late.store(0);
+
+	silk::fast_random random(uint32_t(42));
+
+	// a burst of requests arrives at once, with SLAs from min_sla_ms to max_sla_ms
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int r = 0; r < requests; r++) {
+		RequestTask& t = *new RequestTask();
+		t.deadline = start + std::chrono::milliseconds(min_sla_ms + random.get() % (max_sla_ms - min_sla_ms));
+
+		silk::demo_runtime_2::spawn_deadline(t, t.deadline);
+	}
+
+	silk::demo_runtime_2::wait_while([]() { return completed.load(std::memory_order_acquire) < requests; });
+
+	const long ms = (long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << (is_deadline_mode ? "deadline mode (EDF): " : "deque (LIFO):        ") << ms << " ms, finished late: " << late.load()
+		<< ", started late (silk::deadline_misses): " << silk::deadline_misses() << " of " << silk::deadline_tasks() << std::endl;
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::cout << requests << " requests with SLAs of " << min_sla_ms << ".." << max_sla_ms << " ms, " << silk::workers_count << " workers" << std::endl;
+
+	serve(false);
+	serve(true);
+
+	return 0;
+}
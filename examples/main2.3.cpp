@@ -0,0 +1,104 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include "parallel_for.h"
+
+const long n = 50000000;
+
+template<typename F> long measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+template<typename F> void static_split(const long size, F f) {
+	const int threads = std::thread::hardware_concurrency();
+
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([=]() { f(t, size * t / threads, size * (t + 1) / threads); });
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::vector<double> a(n);
+
+	auto f = [](const long i) { return std::sin((double)i) * std::cos((double)i); };
+
+	long serial_for = measure([&]() {
+		for (long i = 0; i < n; i++) {
+			a[i] = f(i);
+		}
+	});
+
+	long threads_for = measure([&]() {
+		static_split(n, [&](const int, const long b, const long e) {
+			for (long i = b; i < e; i++) {
+				a[i] = f(i);
+			}
+		});
+	});
+
+	long silk_for = measure([&]() {
+		silk::demo_runtime_2::parallel_for(0L, n, [&](const long i) {
+			a[i] = f(i);
+		});
+	});
+
+	double serial_sum = 0;
+
+	long serial_reduce = measure([&]() {
+		for (long i = 0; i < n; i++) {
+			serial_sum += a[i];
+		}
+	});
+
+	std::vector<double> sums(std::thread::hardware_concurrency());
+
+	long threads_reduce = measure([&]() {
+		static_split(n, [&](const int t, const long b, const long e) {
+			double sum = 0;
+
+			for (long i = b; i < e; i++) {
+				sum += a[i];
+			}
+
+			sums[t] = sum;
+		});
+	});
+
+	double silk_sum = 0;
+
+	long silk_reduce = measure([&]() {
+		silk_sum = silk::demo_runtime_2::parallel_reduce(
+			silk::demo_runtime_2::blocked_range<long>(0, n, 1024),
+			0.0,
+			[&](const silk::demo_runtime_2::blocked_range<long>& r, double sum) {
+				for (long i = r.begin(); i != r.end(); i++) {
+					sum += a[i];
+				}
+
+				return sum;
+			},
+			[](const double x, const double y) { return x + y; }
+		);
+	});
+
+	std::cout << "parallel_for    serial: " << serial_for << " ms, static std::thread: " << threads_for << " ms, silk: " << silk_for << " ms" << std::endl;
+	std::cout << "parallel_reduce serial: " << serial_reduce << " ms, static std::thread: " << threads_reduce << " ms, silk: " << silk_reduce << " ms" << std::endl;
+	std::cout << "sum: " << serial_sum << " " << silk_sum << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <vector>
+#include "parallel_for.h"
+
+const long n = 4096;
+
+template<typename F> long measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::vector<double> a(n * n);
+	std::vector<double> b(n * n);
+
+	for (long i = 0; i < n * n; i++) {
+		a[i] = (double)i;
+	}
+
+	long rows = measure([&]() {
+		silk::demo_runtime_2::parallel_for(silk::demo_runtime_2::blocked_range<long>(0, n), [&](const silk::demo_runtime_2::blocked_range<long>& r) {
+			for (long i = r.begin(); i != r.end(); i++) {
+				for (long j = 0; j < n; j++) {
+					b[j * n + i] = a[i * n + j];
+				}
+			}
+		});
+	});
+
+	long tiles = measure([&]() {
+		silk::demo_runtime_2::parallel_for(silk::demo_runtime_2::blocked_range2d<long>(0, n, 0, n), [&](const silk::demo_runtime_2::blocked_range2d<long>& r) {
+			for (long i = r.rows().begin(); i != r.rows().end(); i++) {
+				for (long j = r.cols().begin(); j != r.cols().end(); j++) {
+					b[j * n + i] = a[i * n + j];
+				}
+			}
+		});
+	});
+
+	std::cout << "transpose " << n << "x" << n << " row-wise: " << rows << " ms, blocked_range2d: " << tiles << " ms" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <vector>
+#include <numeric>
+#include <random>
+#include <stdlib.h>
+#include "parallel_sort.h"
+#include "parallel_scan.h"
+
+template<typename F> double measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+}
+
+int main(int argc, char** argv) {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	// 1K .. 1G elements; pass the largest size as the first argument (default 100M)
+	const long max_size = argc > 1 ? atol(argv[1]) : 100000000;
+
+	std::mt19937 random(42);
+
+	for (long n = 1000; n <= max_size; n *= 10) {
+		std::vector<int> source(n);
+
+		for (auto& v : source) {
+			v = (int) random();
+		}
+
+		std::vector<int> a(source);
+		std::vector<int> b(source);
+
+		double std_sort = measure([&]() { std::sort(a.begin(), a.end()); });
+		double silk_sort = measure([&]() { silk::demo_runtime_2::parallel_sort(b.begin(), b.end()); });
+
+		std::vector<long> out(n);
+
+		double std_scan = measure([&]() { std::inclusive_scan(source.begin(), source.end(), out.begin(), std::plus<long>()); });
+		double silk_scan = measure([&]() { silk::demo_runtime_2::parallel_inclusive_scan(source.begin(), source.end(), out.begin(), std::plus<long>()); });
+
+		std::cout << "n: " << n
+			<< " std::sort: " << std_sort << " ms, parallel_sort: " << silk_sort << " ms"
+			<< " | std::inclusive_scan: " << std_scan << " ms, parallel_inclusive_scan: " << silk_scan << " ms"
+			<< (a == b ? "" : " SORT MISMATCH") << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include "pipeline.h"
+
+const int chunks = 20000;
+const int chunk_lines = 256;
+
+template<typename F> long measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+struct chunk {
+	int index;
+	std::string text;
+	std::vector<double> values;
+	double sum;
+};
+
+std::string make_text(const int index) {
+	std::string text;
+
+	for (int i = 0; i < chunk_lines; i++) {
+		text += std::to_string(index * chunk_lines + i);
+		text += '\n';
+	}
+
+	return text;
+}
+
+void parse(chunk* c) {
+	const char* p = c->text.c_str();
+
+	while (*p) {
+		char* end;
+		c->values.push_back(strtod(p, &end));
+		p = end + 1;
+	}
+}
+
+void transform(chunk* c) {
+	c->sum = 0;
+
+	for (double& v : c->values) {
+		v = std::sqrt(v) * std::log(v + 1);
+		c->sum += v;
+	}
+}
+
+class read_filter : public silk::demo_runtime_2::filter {
+	int next_ = 0;
+public:
+	read_filter() : filter(silk::demo_runtime_2::serial_in_order) {
+	}
+
+	void* operator()(void*) override {
+		if (next_ == chunks)
+			return nullptr;
+
+		chunk* c = new chunk();
+		c->index = next_;
+		c->text = make_text(next_++);
+
+		return c;
+	}
+};
+
+class parse_filter : public silk::demo_runtime_2::filter {
+public:
+	parse_filter() : filter(silk::demo_runtime_2::parallel) {
+	}
+
+	void* operator()(void* item) override {
+		parse((chunk*)item);
+		transform((chunk*)item);
+
+		return item;
+	}
+};
+
+class write_filter : public silk::demo_runtime_2::filter {
+public:
+	std::vector<double> output;
+	bool is_ordered = true;
+
+	write_filter() : filter(silk::demo_runtime_2::serial_in_order) {
+	}
+
+	void* operator()(void* item) override {
+		chunk* c = (chunk*)item;
+
+		is_ordered = is_ordered && c->index == (int)output.size();
+		output.push_back(c->sum);
+
+		delete c;
+
+		// the last filter, its result is not used
+		return nullptr;
+	}
+};
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::vector<double> serial_output;
+
+	long serial = measure([&]() {
+		for (int i = 0; i < chunks; i++) {
+			chunk c;
+			c.index = i;
+			c.text = make_text(i);
+			parse(&c);
+			transform(&c);
+			serial_output.push_back(c.sum);
+		}
+	});
+
+	read_filter input;
+	parse_filter parser;
+	write_filter writer;
+
+	silk::demo_runtime_2::pipeline p;
+	p.add_filter(input);
+	p.add_filter(parser);
+	p.add_filter(writer);
+
+	const size_t tokens = silk::workers_count * 4;
+
+	long silk = measure([&]() {
+		p.run(tokens);
+	});
+
+	std::cout << "serial: " << serial << " ms, pipeline (" << tokens << " tokens): " << silk << " ms, "
+		<< (writer.is_ordered && writer.output == serial_output ? "in order" : "OUT OF ORDER") << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "task_graph.h"
+
+const int grid = 48;
+const int runs = 20;
+
+template<typename F> long measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+// keeps the result of work() that nobody reads
+volatile double sink;
+
+double work(const int amount) {
+	double x = 0;
+
+	for (int i = 1; i <= amount; i++) {
+		x += std::sqrt((double)i) * std::sin((double)i);
+	}
+
+	return x;
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	// wavefront: block (i, j) depends on (i - 1, j) and (i, j - 1)
+	std::vector<double> blocks(grid * grid);
+
+	silk::demo_runtime_2::task_graph wavefront;
+	std::vector<silk::demo_runtime_2::graph_node*> nodes(grid * grid);
+
+	for (int i = 0; i < grid; i++) {
+		for (int j = 0; j < grid; j++) {
+			nodes[i * grid + j] = &wavefront.emplace([&blocks, i, j]() {
+				const double up = i ? blocks[(i - 1) * grid + j] : 0;
+				const double left = j ? blocks[i * grid + j - 1] : 0;
+
+				blocks[i * grid + j] = (up + left) * 0.5 + work(2000);
+			});
+
+			if (i)
+				nodes[i * grid + j]->succeed(*nodes[(i - 1) * grid + j]);
+
+			if (j)
+				nodes[i * grid + j]->succeed(*nodes[i * grid + j - 1]);
+		}
+	}
+
+	long serial = measure([&]() {
+		for (int r = 0; r < runs; r++) {
+			for (int i = 0; i < grid; i++) {
+				for (int j = 0; j < grid; j++) {
+					const double up = i ? blocks[(i - 1) * grid + j] : 0;
+					const double left = j ? blocks[i * grid + j - 1] : 0;
+
+					blocks[i * grid + j] = (up + left) * 0.5 + work(2000);
+				}
+			}
+		}
+	});
+
+	const double serial_result = blocks[grid * grid - 1];
+
+	long graph = measure([&]() {
+		for (int r = 0; r < runs; r++) {
+			wavefront.run();
+		}
+	});
+
+	std::cout << "wavefront " << grid << "x" << grid << " x " << runs << " runs, serial: " << serial << " ms, task_graph: " << graph << " ms, "
+		<< (blocks[grid * grid - 1] == serial_result ? "same result" : "DIFFERENT RESULT") << std::endl;
+
+	// one long chain and many short independent nodes: starting the chain first hides its latency
+	silk::demo_runtime_2::task_graph unbalanced;
+
+	silk::demo_runtime_2::graph_node* previous = nullptr;
+
+	for (int i = 0; i < 64; i++) {
+		silk::demo_runtime_2::graph_node& n = unbalanced.emplace([]() { sink = work(100000); }, 10);
+
+		if (previous)
+			n.succeed(*previous);
+
+		previous = &n;
+	}
+
+	silk::demo_runtime_2::graph_node& root = unbalanced.emplace([]() {});
+
+	for (int i = 0; i < silk::workers_count * 64; i++) {
+		unbalanced.emplace([]() { sink = work(100000); }).succeed(root);
+	}
+
+	long fifo = measure([&]() { unbalanced.run(false); });
+	long critical_path = measure([&]() { unbalanced.run(true); });
+
+	std::cout << "unbalanced graph, successor order: " << fifo << " ms, critical path first: " << critical_path << " ms" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "parallel_for.h"
+
+const long n = 1 << 20;
+const long block = 1 << 12;
+const int sweeps = 200;
+
+template<typename F> long measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+// Jacobi sweeps of a 1D heat equation; returns the share of blocks executed by the same worker as in the previous sweep.
+template<typename Loop> int relax(std::vector<double>& a, std::vector<double>& b, Loop loop) {
+	std::vector<int> owner(n / block, -1);
+
+	long same = 0;
+	long total = 0;
+
+	for (int s = 0; s < sweeps; s++) {
+		std::vector<int> previous = owner;
+
+		loop(silk::demo_runtime_2::blocked_range<long>(1, n - 1, block), [&](const silk::demo_runtime_2::blocked_range<long>& r) {
+			for (long i = r.begin(); i != r.end(); i++) {
+				b[i] = 0.5 * a[i] + 0.25 * (a[i - 1] + a[i + 1]);
+			}
+
+			owner[r.begin() / block] = silk::current_worker_id;
+		});
+
+		for (size_t i = 0; i < owner.size(); i++) {
+			same += s > 0 && owner[i] == previous[i];
+			total += s > 0;
+		}
+
+		std::swap(a, b);
+	}
+
+	return int(100 * same / total);
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	std::vector<double> a(n), b(n);
+
+	auto reset = [&]() {
+		for (long i = 0; i < n; i++) {
+			a[i] = b[i] = i % 64 == 0 ? 1.0 : 0.0;
+		}
+	};
+
+	int simple_same, affinity_same;
+
+	reset();
+
+	long simple = measure([&]() {
+		simple_same = relax(a, b, [](const auto& range, const auto& body) {
+			silk::demo_runtime_2::parallel_for(range, body);
+		});
+	});
+
+	const double simple_checksum = a[n / 2] + a[n / 3];
+
+	reset();
+
+	silk::demo_runtime_2::affinity_partitioner partitioner;
+
+	long affinity = measure([&]() {
+		affinity_same = relax(a, b, [&partitioner](const auto& range, const auto& body) {
+			silk::demo_runtime_2::parallel_for(range, body, partitioner);
+		});
+	});
+
+	const double affinity_checksum = a[n / 2] + a[n / 3];
+
+	std::cout << sweeps << " sweeps over " << n << " doubles" << std::endl;
+	std::cout << "parallel_for:                       " << simple << " ms, blocks on the same worker as the sweep before: " << simple_same << "%" << std::endl;
+	std::cout << "parallel_for, affinity_partitioner: " << affinity << " ms, blocks on the same worker as the sweep before: " << affinity_same << "%" << std::endl;
+	std::cout << (simple_checksum == affinity_checksum ? "same result" : "DIFFERENT RESULTS") << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <cmath>
+#include "taskruntime2.h"
+
+const long jobs = 4;
+const long fan_out = 1 << 20;
+
+std::atomic<long> live_tasks;
+std::atomic<long> peak_live_tasks;
+std::atomic<double> total;
+
+template<typename F> long measure(F f) {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	f();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+struct LeafTask : public silk::demo_runtime_2::task {
+	long i;
+	LeafTask(long i_) : i(i_) {
+		live_tasks.fetch_add(1, std::memory_order_relaxed);
+	}
+	~LeafTask() {
+		live_tasks.fetch_sub(1, std::memory_order_relaxed);
+	}
+	task* execute() override {
+		double x = 0;
+
+		for (long k = 1; k < 64; k++) {
+			x += std::sqrt((double)(i + k));
+		}
+
+		double t = total.load(std::memory_order_relaxed);
+		while (!total.compare_exchange_weak(t, t + x, std::memory_order_relaxed)) {
+		}
+
+		return nullptr;
+	}
+};
+
+// A bursty job: one task spawns its whole fan-out before any of it is done.
+struct BurstTask : public silk::demo_runtime_2::task {
+	task* done;
+	BurstTask(task* done_) : done(done_) {
+	}
+	task* execute() override {
+		for (long i = 0; i < fan_out; i++) {
+			LeafTask& t = *new LeafTask(i);
+			t.set_continuation(*done);
+			silk::demo_runtime_2::spawn(t);
+
+			const long live = live_tasks.load(std::memory_order_relaxed);
+			long peak = peak_live_tasks.load(std::memory_order_relaxed);
+
+			while (live > peak && !peak_live_tasks.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+			}
+		}
+
+		return nullptr;
+	}
+};
+
+long run_jobs() {
+	total.store(0);
+	peak_live_tasks.store(0);
+
+	silk::demo_runtime_2::empty_task* done = new silk::demo_runtime_2::empty_task();
+	done->set_ref_count(jobs * fan_out + 1);
+
+	for (long j = 0; j < jobs; j++) {
+		silk::demo_runtime_2::spawn(*new BurstTask(done));
+	}
+
+	silk::demo_runtime_2::wait_while([done]() { return done->ref_count() > 1; });
+
+	delete done;
+
+	return peak_live_tasks.load();
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_2::schedule, silk::demo_runtime_2::makeuwcontext);
+
+	long peak;
+
+	long unlimited = measure([&]() { peak = run_jobs(); });
+
+	const double unlimited_total = total.load();
+
+	std::cout << jobs << " jobs, each spawns " << fan_out << " tasks" << std::endl;
+	std::cout << "no limit:             " << unlimited << " ms, peak live tasks: " << peak << std::endl;
+
+	silk::set_spawn_limits(256);
+
+	long limited = measure([&]() { peak = run_jobs(); });
+
+	std::cout << "256 queued per worker: " << limited << " ms, peak live tasks: " << peak << " (workers: " << silk::workers_count << ")" << std::endl;
+	std::cout << (std::abs(unlimited_total - total.load()) < 1e-6 * unlimited_total ? "same result" : "DIFFERENT RESULTS") << std::endl;
+
+	return 0;
+}
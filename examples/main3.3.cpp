@@ -0,0 +1,62 @@
+#define _XOPEN_SOURCE 600
+#include <ucontext.h>
+#include <iostream>
+#include <chrono>
+#include "./../src/silk_context.h"
+
+const long switches = 10000000;
+
+ucontext_t main_ucontext;
+ucontext_t coro_ucontext;
+
+silk::coro_context main_context;
+silk::coro_context coro_context;
+
+void ucontext_coro() {
+	while (1) {
+		swapcontext(&coro_ucontext, &main_ucontext);
+	}
+}
+
+void silk_coro(const long n) {
+	for (long i = 0; i < n; i++) {
+		silk::swap_coro_context(&coro_context, &main_context);
+	}
+}
+
+int main() {
+	char* ucontext_stack = new char[32768];
+	getcontext(&coro_ucontext);
+	coro_ucontext.uc_stack.ss_sp = ucontext_stack;
+	coro_ucontext.uc_stack.ss_size = 32768;
+	makecontext(&coro_ucontext, ucontext_coro, 0);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (long i = 0; i < switches; i++) {
+		swapcontext(&main_ucontext, &coro_ucontext);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	std::cout << "swapcontext: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (2.0 * switches) << " ns/switch" << std::endl;
+
+	char* stack = new char[32768];
+	silk::make_coro_context(&coro_context, (void(*)()) silk_coro, stack, 32768, 1, switches);
+	coro_context.link = &main_context;
+
+	start = std::chrono::high_resolution_clock::now();
+
+	for (long i = 0; i <= switches; i++) {
+		silk::swap_coro_context(&main_context, &coro_context);
+	}
+
+	end = std::chrono::high_resolution_clock::now();
+
+	std::cout << "swap_coro_context: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (2.0 * switches) << " ns/switch" << std::endl;
+
+	delete[] stack;
+	delete[] ucontext_stack;
+
+	return 0;
+}
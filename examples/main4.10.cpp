@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include "./taskruntime4.2.h"
+#include "./coroutine_sync.h"
+
+const int coroutines_count = 64;
+const int increments = 10000;
+const int max_active = 4;
+const int phases = 100;
+
+silk::demo_coroutines::async_mutex counter_mutex;
+long counter = 0;
+
+silk::demo_coroutines::async_semaphore slots(max_active);
+std::atomic<int> active;
+std::atomic<int> peak_active;
+
+silk::demo_coroutines::async_barrier phase_barrier(coroutines_count);
+std::vector<int> phase_values(coroutines_count);
+std::atomic<int> phase_errors;
+
+silk::demo_coroutines::async_latch done_latch(coroutines_count);
+std::atomic<bool> is_done;
+
+silk::demo_runtime_4_2::independed_task worker(const int id) {
+	// mutex: a plain long incremented by every coroutine
+	for (int i = 0; i < increments; i++) {
+		auto guard = co_await counter_mutex.scoped_lock();
+
+		if (i % 1000 == 0) {
+			// suspended while holding the lock, the others queue up behind it
+			co_await silk::demo_runtime_4_2::yield();
+		}
+
+		counter++;
+	}
+
+	// semaphore: at most max_active coroutines between acquire and release
+	for (int i = 0; i < 100; i++) {
+		co_await slots.acquire();
+
+		const int a = active.fetch_add(1, std::memory_order_relaxed) + 1;
+
+		int p = peak_active.load(std::memory_order_relaxed);
+		while (a > p && !peak_active.compare_exchange_weak(p, a, std::memory_order_relaxed));
+
+		co_await silk::demo_runtime_4_2::yield();
+
+		active.fetch_sub(1, std::memory_order_relaxed);
+
+		slots.release();
+	}
+
+	// barrier: every phase reads what the others have written in the previous one
+	for (int phase = 1; phase <= phases; phase++) {
+		phase_values[id] = phase;
+
+		co_await phase_barrier.arrive_and_wait();
+
+		if (phase_values[(id + 1) % coroutines_count] != phase) {
+			phase_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		co_await phase_barrier.arrive_and_wait();
+	}
+
+	done_latch.count_down();
+}
+
+silk::demo_runtime_4_2::independed_task waiter() {
+	co_await done_latch.wait();
+
+	is_done.store(true, std::memory_order_release);
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	silk::demo_runtime_4_2::spawn(waiter());
+
+	for (int i = 0; i < coroutines_count; i++) {
+		silk::demo_runtime_4_2::spawn(worker(i));
+	}
+
+	while (!is_done.load(std::memory_order_acquire)) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	printf("%d coroutines in %ld ms\n", coroutines_count, (long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+	printf("async_mutex: counter %ld %s\n", counter, counter == (long) coroutines_count * increments ? "ok" : "WRONG");
+	printf("async_semaphore(%d): peak %d %s\n", max_active, peak_active.load(), peak_active.load() <= max_active ? "ok" : "WRONG");
+	printf("async_barrier: %d phases, phase %d, %s\n", phases, phase_barrier.phase(), phase_errors.load() == 0 ? "ok" : "WRONG");
+	printf("async_latch: ok\n");
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include "./taskruntime4.2.h"
+#include "./coroutine_sync.h"
+
+namespace rt = silk::demo_runtime_4_2;
+
+const int loop_size = 1000000;
+const int tree_fanout = 8;
+const int tree_depth = 6;
+
+std::atomic<long> pending_frames;
+std::atomic<long> peak_pending_frames;
+std::atomic<int> peak_deque;
+std::atomic<long> leaves;
+std::atomic<bool> is_done;
+
+void update_max(std::atomic<long>& m, const long v) {
+	long c = m.load(std::memory_order_relaxed);
+	while (v > c && !m.compare_exchange_weak(c, v, std::memory_order_relaxed));
+}
+
+// called before every fork: a frame is created and lives until its coroutine completes
+void frame_created() {
+	update_max(peak_pending_frames, pending_frames.fetch_add(1, std::memory_order_relaxed) + 1);
+}
+
+// called when a forked coroutine starts: what its worker has queued meanwhile (the parent too, if it is stealable)
+void sample_deque() {
+	const int d = silk::wcontexts[silk::current_worker_id]->tasks_count.load(std::memory_order_relaxed);
+
+	int c = peak_deque.load(std::memory_order_relaxed);
+	while (d > c && !peak_deque.compare_exchange_weak(c, d, std::memory_order_relaxed));
+}
+
+void work() {
+	volatile int x = 0; // keeps the loop, a plain read and write per step
+
+	for (int i = 0; i < 100; i++) {
+		x = x + i;
+	}
+
+	leaves.fetch_add(1, std::memory_order_relaxed);
+}
+
+rt::independed_task leaf(silk::demo_coroutines::async_latch& done) {
+	sample_deque();
+
+	work();
+
+	pending_frames.fetch_sub(1, std::memory_order_relaxed);
+
+	done.count_down();
+
+	co_return;
+}
+
+rt::independed_task node(const int depth, silk::demo_coroutines::async_latch& done) {
+	sample_deque();
+
+	if (depth == 0) {
+		work();
+	} else {
+		silk::demo_coroutines::async_latch children(tree_fanout);
+
+		for (int i = 0; i < tree_fanout; i++) {
+			frame_created();
+
+			co_await rt::fork(node(depth - 1, children));
+		}
+
+		co_await children.wait();
+	}
+
+	pending_frames.fetch_sub(1, std::memory_order_relaxed);
+
+	done.count_down();
+}
+
+rt::task<> flat_loop() {
+	silk::demo_coroutines::async_latch done(loop_size);
+
+	for (int i = 0; i < loop_size; i++) {
+		frame_created();
+
+		co_await rt::fork(leaf(done));
+	}
+
+	co_await done.wait();
+}
+
+rt::task<> tree() {
+	silk::demo_coroutines::async_latch done(1);
+
+	frame_created();
+
+	co_await rt::fork(node(tree_depth, done));
+
+	co_await done.wait();
+}
+
+const char* policy_names[] = { "help_first", "work_first", "continuation_stealing" };
+
+template<typename F> rt::task<> measure(const char* name, F body) {
+	for (int policy = rt::help_first; policy <= rt::continuation_stealing; policy++) {
+		rt::set_spawn_policy((rt::spawn_policy) policy);
+
+		pending_frames.store(0);
+		peak_pending_frames.store(0);
+		peak_deque.store(0);
+		leaves.store(0);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		co_await body();
+
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		printf("%-10s %-22s %8ld ms, leaves %ld, peak deque %d, peak pending frames %ld\n", name, policy_names[policy],
+			(long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), leaves.load(), peak_deque.load(), peak_pending_frames.load());
+	}
+}
+
+rt::independed_task benchmark() {
+	co_await measure("loop", flat_loop);
+	co_await measure("tree", tree);
+
+	is_done.store(true, std::memory_order_release);
+}
+
+int main() {
+	silk::init_pool(rt::schedule, silk::makecontext);
+
+	rt::spawn(benchmark());
+
+	while (!is_done.load(std::memory_order_acquire)) {
+		silk::join_main_thread_2_pool(rt::schedule);
+	}
+
+	return 0;
+}
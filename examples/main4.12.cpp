@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include "./taskruntime4.2.h"
+#include "./channel.h"
+
+const int pairs = 4;
+const int round_trips = 200000;
+
+std::atomic<int> playing;
+std::atomic<long> same_worker_resumes;
+std::atomic<long> resumes;
+
+struct table {
+	silk::demo_coroutines::channel<int> ping{ 1 };
+	silk::demo_coroutines::channel<int> pong{ 1 };
+};
+
+table tables[pairs];
+
+silk::demo_runtime_4_2::independed_task ping(table& t) {
+	long same = 0;
+
+	for (int i = 0; i < round_trips; i++) {
+		const int worker = silk::current_worker_id;
+
+		co_await t.ping.send(i);
+
+		auto r = co_await t.pong.recv();
+
+		same += silk::current_worker_id == worker;
+
+		if (!r || *r != i) {
+			printf("WRONG reply %d\n", i);
+		}
+	}
+
+	t.ping.close();
+
+	same_worker_resumes.fetch_add(same, std::memory_order_relaxed);
+	resumes.fetch_add(round_trips, std::memory_order_relaxed);
+	playing.fetch_sub(1, std::memory_order_release);
+}
+
+silk::demo_runtime_4_2::independed_task pong(table& t) {
+	while (auto v = co_await t.ping.recv()) {
+		co_await t.pong.send(*v);
+	}
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	playing.store(pairs);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	for (int p = 0; p < pairs; p++) {
+		silk::demo_runtime_4_2::spawn(pong(tables[p]));
+		silk::demo_runtime_4_2::spawn(ping(tables[p]));
+	}
+
+	while (playing.load(std::memory_order_acquire) > 0) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	const long ns = (long) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	printf("%d ping-pong pairs x %d round trips: %ld ms, %ld ns per round trip, %ld%% resumed on the same worker\n", pairs, round_trips,
+		ns / 1000000, ns / ((long) pairs * round_trips), 100 * same_worker_resumes.load() / resumes.load());
+
+	return 0;
+}
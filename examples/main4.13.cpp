@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <cmath>
+#include "./taskruntime4.2.h"
+
+const int slow_requests = 8;
+const int syncs = 5;
+const int quick_requests = 4000;
+
+enum blocking_mode { on_worker, in_blocking_region, with_spawn_blocking };
+
+std::atomic<int> pending_quick;
+std::atomic<int> pending_slow;
+
+double work(const int amount) {
+	double x = 0;
+
+	for (int i = 1; i <= amount; i++) {
+		x += std::sqrt((double)i) * std::sin((double)i);
+	}
+
+	return x;
+}
+
+// stands in for an fsync of a slow disk
+int slow_sync() {
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	return 1;
+}
+
+silk::demo_runtime_4_2::independed_task slow_request(const blocking_mode mode) {
+	int synced = 0;
+
+	for (int i = 0; i < syncs; i++) {
+		work(20000);
+
+		if (mode == on_worker) {
+			synced += slow_sync();
+		} else if (mode == in_blocking_region) {
+			silk::blocking_region r;
+
+			synced += slow_sync();
+		} else {
+			synced += co_await silk::demo_runtime_4_2::spawn_blocking(slow_sync);
+		}
+	}
+
+	if (synced == syncs) {
+		pending_slow.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+silk::demo_runtime_4_2::independed_task quick_request() {
+	work(20000);
+
+	pending_quick.fetch_sub(1, std::memory_order_release);
+
+	co_return;
+}
+
+void serve(const blocking_mode mode, const char* name) {
+	pending_quick.store(quick_requests);
+	pending_slow.store(slow_requests);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	for (int s = 0; s < slow_requests; s++) {
+		silk::demo_runtime_4_2::spawn(slow_request(mode));
+	}
+
+	for (int q = 0; q < quick_requests; q++) {
+		silk::demo_runtime_4_2::spawn(quick_request());
+	}
+
+	while (pending_quick.load(std::memory_order_acquire) > 0) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto quick_done = std::chrono::high_resolution_clock::now();
+
+	while (pending_slow.load(std::memory_order_acquire) > 0) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	printf("%-22s quick requests done in %4ld ms, all in %4ld ms, blocking threads: %d\n", name,
+		(long) std::chrono::duration_cast<std::chrono::milliseconds>(quick_done - start).count(),
+		(long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), silk::blocking_threads->threads_count());
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	printf("%d slow requests x %d syncs of 20 ms, %d quick requests, %d workers\n", slow_requests, syncs, quick_requests, silk::workers_count);
+
+	serve(on_worker, "blocking on the worker");
+	serve(in_blocking_region, "blocking_region");
+	serve(with_spawn_blocking, "spawn_blocking");
+
+	return 0;
+}
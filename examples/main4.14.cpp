@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <cmath>
+#include <vector>
+#include "./taskruntime4.2.h"
+#include "./channel.h"
+
+const int items = 1 << 19;
+const int probe_every = 1 << 14;
+
+std::atomic<int> pending_consumers;
+std::atomic<int> pending_probes;
+std::atomic<long> total_probe_delay_us;
+std::atomic<long> max_probe_delay_us;
+
+// Another connection on the same worker: how long did it wait to run?
+silk::demo_runtime_4_2::independed_task probe(const std::chrono::steady_clock::time_point spawned) {
+	const long us = (long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - spawned).count();
+
+	total_probe_delay_us.fetch_add(us, std::memory_order_relaxed);
+
+	long m = max_probe_delay_us.load(std::memory_order_relaxed);
+
+	while (us > m && !max_probe_delay_us.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+	}
+
+	pending_probes.fetch_sub(1, std::memory_order_release);
+
+	co_return;
+}
+
+// A connection with a constant stream of data: every recv completes at once.
+silk::demo_runtime_4_2::independed_task consumer(silk::demo_coroutines::channel<long>& ch) {
+	double x = 0;
+	long received = 0;
+
+	while (auto v = co_await ch.recv()) {
+		for (int k = 1; k < 16; k++) {
+			x += std::sqrt((double)(*v + k));
+		}
+
+		if (++received % probe_every == 0) {
+			pending_probes.fetch_add(1, std::memory_order_relaxed);
+
+			silk::demo_runtime_4_2::spawn(probe(std::chrono::steady_clock::now()));
+		}
+	}
+
+	if (x > 0) {
+		pending_consumers.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void run(const int budget) {
+	silk::set_task_budget(budget);
+	silk::reset_budget_stats();
+
+	total_probe_delay_us.store(0);
+	max_probe_delay_us.store(0);
+	pending_probes.store(0);
+	pending_consumers.store(silk::workers_count);
+
+	std::vector<silk::demo_coroutines::channel<long>*> channels;
+
+	for (int w = 0; w < silk::workers_count; w++) {
+		channels.push_back(new silk::demo_coroutines::channel<long>(items));
+
+		for (long i = 0; i < items; i++) {
+			channels.back()->try_send(i);
+		}
+
+		channels.back()->close();
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int w = 0; w < silk::workers_count; w++) {
+		silk::demo_runtime_4_2::spawn(consumer(*channels[w]));
+	}
+
+	while (pending_consumers.load(std::memory_order_acquire) > 0 || pending_probes.load(std::memory_order_acquire) > 0) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const long ms = (long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	const long probes = (long) silk::workers_count * (items / probe_every);
+
+	printf("budget %4d: %4ld ms, probe delay avg %6ld us, max %6ld us | budget spent %ld, forced yields %ld\n", budget, ms,
+		total_probe_delay_us.load() / probes, max_probe_delay_us.load(), silk::budget_spent(), silk::budget_yields());
+
+	for (auto ch : channels) {
+		delete ch;
+	}
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	printf("%d consumers that never wait, %d items each\n", silk::workers_count, items);
+
+	run(0);
+	run(128);
+	run(16);
+
+	return 0;
+}
@@ -11,6 +11,8 @@
 #include <unistd.h>
 #include "./taskruntime4.2.h"
 
+const int max_connections = 1000;
+
 silk::demo_runtime_4_2::independed_task process_connection(const int s) {
     char buf[1024];
     int n;
@@ -72,6 +74,8 @@ int main() {
         co_return;
     };
 
+    silk::demo_runtime_4_2::async_scope connections( max_connections );
+
     auto server = [&]( int listening_socket ) -> silk::demo_runtime_4_2::independed_task {
         while ( 1 ) {
             auto[ s, addr, err ] = co_await silk::demo_runtime_4_2::accept_async( listening_socket );
@@ -79,7 +83,7 @@ int main() {
             if ( s ) {
                 silk::demo_runtime_4_2::task<> c = silk::demo_runtime_4_2::spawn( log_new_connection( s, addr ) );
            
-                silk::demo_runtime_4_2::spawn( process_connection( s ) );
+                co_await connections.spawn( [s]() { return process_connection( s ); } ); // waits while max_connections are open
            
                 co_await c;
             }
@@ -12,6 +12,8 @@
 #include <arpa/inet.h>
 #include "./taskruntime4.3.h"
 
+const int max_connections = 1000;
+
 silk::demo_runtime_4_3::independed_task process_connection(const int s) {
     char buf[1024];
     int n;
@@ -77,12 +79,14 @@ int main() {
         co_return;
     };
 
+    silk::demo_runtime_4_3::async_scope connections( max_connections );
+
     auto server = [&]( int listening_socket ) -> silk::demo_runtime_4_3::independed_task {
         while ( 1 ) {
             auto[ s, addr, err ] = co_await silk::demo_runtime_4_3::accept_async( listening_socket );
             
             if ( s ) {
-                process_connection( s );
+                co_await connections.spawn( [s]() { return process_connection( s ); } ); // waits while max_connections are open
            
                 co_await log_new_connection( s, addr );
             }
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "./taskruntime4.2.h"
+
+const int requests = 20000;
+const int lookups = 6;
+
+std::atomic<int> count;
+std::atomic<long> checksum;
+
+// a backend lookup: some work split by a suspension point
+silk::demo_runtime_4_2::task<int> lookup(const int request, const int backend) {
+	volatile double x = 0;
+
+	for (int i = 0; i < 2000; i++) {
+		x = x + std::sqrt((double)i);
+	}
+
+	co_await silk::demo_runtime_4_2::yield();
+
+	co_return request % 7 + backend;
+}
+
+// the slowest lookup gives up when another one already answered
+silk::demo_runtime_4_2::task<int> cancellable_lookup(const int, const int backend) {
+	for (int i = 0; i < backend * 4; i++) {
+		if (co_await silk::demo_runtime_4_2::is_cancelled())
+			co_return -1;
+
+		co_await silk::demo_runtime_4_2::yield();
+	}
+
+	co_return backend;
+}
+
+silk::demo_runtime_4_2::independed_task sequential_handler(const int request) {
+	int sum = 0;
+
+	for (int b = 0; b < lookups; b++) {
+		sum += co_await lookup(request, b);
+	}
+
+	checksum.fetch_add(sum, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_release);
+}
+
+silk::demo_runtime_4_2::independed_task fan_out_handler(const int request) {
+	std::vector<silk::demo_runtime_4_2::task<int>> calls;
+	calls.reserve(lookups);
+
+	for (int b = 0; b < lookups; b++) {
+		calls.push_back(lookup(request, b));
+	}
+
+	co_await silk::demo_runtime_4_2::when_all(calls);
+
+	int sum = 0;
+
+	for (auto& c : calls) {
+		sum += c.result();
+	}
+
+	checksum.fetch_add(sum, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_release);
+}
+
+silk::demo_runtime_4_2::independed_task first_answer_handler(const int request) {
+	auto a = cancellable_lookup(request, 3);
+	auto b = cancellable_lookup(request, 1);
+	auto c = cancellable_lookup(request, 2);
+
+	int first = co_await silk::demo_runtime_4_2::when_any(a, b, c);
+
+	checksum.fetch_add(first, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_release);
+}
+
+template<typename F> long run(F handler) {
+	count.store(0);
+	checksum.store(0);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < requests; i++) {
+		silk::demo_runtime_4_2::spawn(handler(i));
+	}
+
+	while (count.load(std::memory_order_acquire) < requests) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	long sequential = run(sequential_handler);
+	long sequential_checksum = checksum.load();
+
+	long fan_out = run(fan_out_handler);
+	long fan_out_checksum = checksum.load();
+
+	long first_answer = run(first_answer_handler);
+
+	printf("%d requests x %d lookups, sequential co_await: %ld ms, when_all: %ld ms (%s)\n", requests, lookups, sequential, fan_out,
+		sequential_checksum == fan_out_checksum ? "same results" : "DIFFERENT RESULTS");
+	printf("when_any of 3 lookups: %ld ms, winner index sum: %ld\n", first_answer, checksum.load());
+
+	return 0;
+}
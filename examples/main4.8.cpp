@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include "./taskruntime4.2.h"
+
+const int jobs = 100000;
+const int max_concurrency = 8;
+
+std::atomic<int> running;
+std::atomic<int> peak;
+std::atomic<int> done;
+std::atomic<bool> is_joined;
+
+silk::demo_runtime_4_2::independed_task job(const int i) {
+	int r = running.fetch_add(1, std::memory_order_acq_rel) + 1;
+	int p = peak.load(std::memory_order_relaxed);
+
+	while (r > p && !peak.compare_exchange_weak(p, r, std::memory_order_relaxed)) {
+	}
+
+	for (int k = 0; k < i % 4; k++) {
+		co_await silk::demo_runtime_4_2::yield();
+	}
+
+	running.fetch_sub(1, std::memory_order_acq_rel);
+	done.fetch_add(1, std::memory_order_release);
+}
+
+silk::demo_runtime_4_2::independed_task spawner(silk::demo_runtime_4_2::async_scope& scope) {
+	for (int i = 0; i < jobs; i++) {
+		co_await scope.spawn([i]() { return job(i); });
+	}
+
+	co_await scope.join();
+
+	is_joined.store(true, std::memory_order_release);
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	silk::demo_runtime_4_2::async_scope scope(max_concurrency);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	silk::demo_runtime_4_2::spawn(spawner(scope));
+
+	while (!is_joined.load(std::memory_order_acquire)) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	printf("jobs: %d done: %d, max concurrency: %d peak: %d, time: %ld ms\n", jobs, done.load(), max_concurrency, peak.load(),
+		(long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+	return 0;
+}
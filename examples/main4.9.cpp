@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include "./taskruntime4.2.h"
+#include "./channel.h"
+
+const int producers = 4;
+const int consumers = 4;
+const int messages = 1000000;
+
+silk::demo_coroutines::channel<long> ch(256);
+
+std::atomic<int> producing;
+std::atomic<int> consuming;
+std::atomic<long> received_sum;
+std::atomic<long> received_count;
+
+silk::demo_runtime_4_2::independed_task producer(const int p) {
+	for (long i = p; i < messages; i += producers) {
+		co_await ch.send(i);
+	}
+
+	if (producing.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		ch.close();
+	}
+}
+
+silk::demo_runtime_4_2::independed_task consumer() {
+	std::vector<long> batch(64);
+
+	long sum = 0;
+	long count = 0;
+
+	while (1) {
+		size_t n = co_await ch.recv_batch(batch.begin(), batch.size());
+
+		if (n == 0)
+			break;
+
+		for (size_t i = 0; i < n; i++) {
+			sum += batch[i];
+		}
+
+		count += n;
+	}
+
+	received_sum.fetch_add(sum, std::memory_order_relaxed);
+	received_count.fetch_add(count, std::memory_order_relaxed);
+	consuming.fetch_sub(1, std::memory_order_release);
+}
+
+int main() {
+	silk::init_pool(silk::demo_runtime_4_2::schedule, silk::makecontext);
+
+	producing.store(producers);
+	consuming.store(consumers);
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	for (int c = 0; c < consumers; c++) {
+		silk::demo_runtime_4_2::spawn(consumer());
+	}
+
+	for (int p = 0; p < producers; p++) {
+		silk::demo_runtime_4_2::spawn(producer(p));
+	}
+
+	while (consuming.load(std::memory_order_acquire) > 0) {
+		silk::join_main_thread_2_pool(silk::demo_runtime_4_2::schedule);
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	const long expected = (long) messages * (messages - 1) / 2;
+
+	printf("%d producers -> channel(256) -> %d consumers: %ld messages in %ld ms, sum %s\n", producers, consumers, received_count.load(),
+		(long) std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), received_sum.load() == expected ? "ok" : "WRONG");
+
+	return 0;
+}
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <new>
+#include <utility>
+#include <vector>
+#include "./taskruntime2.h"
+
+namespace silk {
+    namespace demo_runtime_2 {
+        struct split {};
+        
+        template<typename Value> class blocked_range {
+        	Value begin_;
+        	Value end_;
+        	size_t grainsize_;
+        public:
+        	blocked_range(Value begin, Value end, size_t grainsize = 1) : begin_(begin), end_(end), grainsize_(grainsize) {
+        	}
+        
+        	blocked_range(blocked_range& r, split) : begin_(r.begin_ + (r.end_ - r.begin_) / 2), end_(r.end_), grainsize_(r.grainsize_) {
+        		r.end_ = begin_;
+        	}
+        
+        	Value begin() const { return begin_; }
+        
+        	Value end() const { return end_; }
+        
+        	size_t size() const { return size_t(end_ - begin_); }
+        
+        	size_t grainsize() const { return grainsize_; }
+        
+        	bool empty() const { return !(begin_ < end_); }
+        
+        	bool is_divisible() const { return grainsize_ < size(); }
+        };
+        
+        // Splits along its longest dimension, so recursive halving yields square-ish
+        // tiles and the depth-first traversal of the pieces stays cache-oblivious.
+        template<typename RowValue, typename ColValue = RowValue> class blocked_range2d {
+        	blocked_range<RowValue> rows_;
+        	blocked_range<ColValue> cols_;
+        
+        	bool is_rows_split() const {
+        		return !cols_.is_divisible() || (rows_.is_divisible() && rows_.size() >= cols_.size());
+        	}
+        public:
+        	blocked_range2d(RowValue rows_begin, RowValue rows_end, size_t rows_grainsize, ColValue cols_begin, ColValue cols_end, size_t cols_grainsize) :
+        		rows_(rows_begin, rows_end, rows_grainsize), cols_(cols_begin, cols_end, cols_grainsize) {
+        	}
+        
+        	blocked_range2d(RowValue rows_begin, RowValue rows_end, ColValue cols_begin, ColValue cols_end) :
+        		rows_(rows_begin, rows_end, 32), cols_(cols_begin, cols_end, 32) {
+        	}
+        
+        	blocked_range2d(blocked_range2d& r, split) : rows_(r.rows_), cols_(r.cols_) {
+        		if (r.is_rows_split()) {
+        			rows_ = blocked_range<RowValue>(r.rows_, split());
+        		} else {
+        			cols_ = blocked_range<ColValue>(r.cols_, split());
+        		}
+        	}
+        
+        	const blocked_range<RowValue>& rows() const { return rows_; }
+        
+        	const blocked_range<ColValue>& cols() const { return cols_; }
+        
+        	bool empty() const { return rows_.empty() || cols_.empty(); }
+        
+        	bool is_divisible() const { return rows_.is_divisible() || cols_.is_divisible(); }
+        };
+        
+        template<typename PageValue, typename RowValue = PageValue, typename ColValue = RowValue> class blocked_range3d {
+        	blocked_range<PageValue> pages_;
+        	blocked_range<RowValue> rows_;
+        	blocked_range<ColValue> cols_;
+        public:
+        	blocked_range3d(PageValue pages_begin, PageValue pages_end, size_t pages_grainsize, RowValue rows_begin, RowValue rows_end, size_t rows_grainsize, ColValue cols_begin, ColValue cols_end, size_t cols_grainsize) :
+        		pages_(pages_begin, pages_end, pages_grainsize), rows_(rows_begin, rows_end, rows_grainsize), cols_(cols_begin, cols_end, cols_grainsize) {
+        	}
+        
+        	blocked_range3d(PageValue pages_begin, PageValue pages_end, RowValue rows_begin, RowValue rows_end, ColValue cols_begin, ColValue cols_end) :
+        		pages_(pages_begin, pages_end, 16), rows_(rows_begin, rows_end, 16), cols_(cols_begin, cols_end, 16) {
+        	}
+        
+        	blocked_range3d(blocked_range3d& r, split) : pages_(r.pages_), rows_(r.rows_), cols_(r.cols_) {
+        		const bool is_rows_longer_than_cols = !r.cols_.is_divisible() || r.rows_.size() >= r.cols_.size();
+        
+        		if (r.pages_.is_divisible() && (!r.rows_.is_divisible() || r.pages_.size() >= r.rows_.size()) && (!r.cols_.is_divisible() || r.pages_.size() >= r.cols_.size())) {
+        			pages_ = blocked_range<PageValue>(r.pages_, split());
+        		} else if (r.rows_.is_divisible() && is_rows_longer_than_cols) {
+        			rows_ = blocked_range<RowValue>(r.rows_, split());
+        		} else {
+        			cols_ = blocked_range<ColValue>(r.cols_, split());
+        		}
+        	}
+        
+        	const blocked_range<PageValue>& pages() const { return pages_; }
+        
+        	const blocked_range<RowValue>& rows() const { return rows_; }
+        
+        	const blocked_range<ColValue>& cols() const { return cols_; }
+        
+        	bool empty() const { return pages_.empty() || rows_.empty() || cols_.empty(); }
+        
+        	bool is_divisible() const { return pages_.is_divisible() || rows_.is_divisible() || cols_.is_divisible(); }
+        };
+        
+        const int max_range_depth = 32;
+        
+        //---------------------------------------------------------
+        // Pending pieces of a range being executed by one task. The top is
+        // split down to a leaf and executed; when a thief is hungry the
+        // bottom (largest, rightmost) piece is handed off as a new task.
+        //---------------------------------------------------------
+        template<typename Range> class range_stack {
+        	alignas(Range) unsigned char ranges_[max_range_depth][sizeof(Range)];
+        	int size_ = 0;
+        
+        	Range& at(const int i) { return *reinterpret_cast<Range*>(ranges_[i]); }
+        public:
+        	range_stack(const Range& r) {
+        		new (ranges_[size_++]) Range(r);
+        	}
+        
+        	~range_stack() {
+        		while (size_) {
+        			at(--size_).~Range();
+        		}
+        	}
+        
+        	int size() const { return size_; }
+        
+        	bool empty() const { return size_ == 0; }
+        
+        	Range& back() { return at(size_ - 1); }
+        
+        	// splits the top until it is a leaf or the depth limit is reached, the top stays leftmost
+        	void split_back(const int depth) {
+        		while (size_ < depth && back().is_divisible()) {
+        			Range& r = back();
+        			new (ranges_[size_]) Range(r, split());
+        			std::swap(r, at(size_));
+        			size_++;
+        		}
+        	}
+        
+        	void pop_back() {
+        		at(--size_).~Range();
+        	}
+        
+        	bool is_offloadable() {
+        		return size_ > 1 || (size_ == 1 && at(0).is_divisible());
+        	}
+        
+        	Range pop_front() {
+        		if (size_ == 1) {
+        			return Range(at(0), split());
+        		}
+        
+        		Range r(std::move(at(0)));
+        
+        		for (int i = 1; i < size_; i++) {
+        			at(i - 1) = std::move(at(i));
+        		}
+        
+        		pop_back();
+        
+        		return r;
+        	}
+        };
+        
+        inline int range_depth() {
+        	int depth = 4;
+        
+        	for (int w = silk::workers_count; w > 1; w >>= 1) {
+        		depth++;
+        	}
+        
+        	return depth < max_range_depth ? depth : max_range_depth;
+        }
+        
+        // How deep a task splits its range before executing a leaf. Linear ranges stop
+        // early and leave further splitting to demand; multidimensional ranges are
+        // always split down to their grainsize tiles so leaves fit in cache.
+        template<typename Range> int split_depth(const Range&) {
+        	return range_depth();
+        }
+        
+        template<typename RowValue, typename ColValue> int split_depth(const blocked_range2d<RowValue, ColValue>&) {
+        	return max_range_depth;
+        }
+        
+        template<typename PageValue, typename RowValue, typename ColValue> int split_depth(const blocked_range3d<PageValue, RowValue, ColValue>&) {
+        	return max_range_depth;
+        }
+        
+        template<typename Range, typename Body> class parallel_for_task : public task {
+        	Range range_;
+        	const Body& body_;
+        public:
+        	parallel_for_task(const Range& range, const Body& body) : range_(range), body_(body) {
+        	}
+        
+        	task* execute() override {
+        		const int depth = split_depth(range_);
+        
+        		range_stack<Range> pending(range_);
+        
+        		while (!pending.empty()) {
+        			if (pending.is_offloadable() && silk::is_work_demanded(silk::current_worker_id)) {
+        				task* c = continuation();
+        				c->increment_ref_count();
+        
+        				parallel_for_task& t = *new parallel_for_task(pending.pop_front(), body_);
+        				t.set_continuation(*c);
+        				spawn(t);
+        
+        				continue;
+        			}
+        
+        			pending.split_back(depth);
+        
+        			body_(pending.back());
+        
+        			pending.pop_back();
+        		}
+        
+        		return nullptr;
+        	}
+        };
+        
+        // Calls body(r) on disjoint pieces of range; blocks (executing other tasks) until all are done.
+        template<typename Range, typename Body> void parallel_for(const Range& range, const Body& body) {
+        	if (range.empty())
+        		return;
+        
+        	spawn_root_and_wait(*new parallel_for_task<Range, Body>(range, body));
+        }
+        
+        template<typename Value, typename Body> void parallel_for(Value begin, Value end, const Body& body) {
+        	parallel_for(blocked_range<Value>(begin, end), [&body](const blocked_range<Value>& r) {
+        		for (Value i = r.begin(); i != r.end(); ++i) {
+        			body(i);
+        		}
+        	});
+        }
+        
+        //---------------------------------------------------------
+        // Remembers which worker executed every piece of a parallel_for.
+        // Passing the same partitioner to the next parallel_for over the same
+        // range mails each piece to that worker again, so a loop re-touching
+        // the same data every sweep finds its piece still in that worker's
+        // cache. Mail is only a preference: the pieces of a busy worker are
+        // stolen as usual and the thief is recorded for the next sweep.
+        //---------------------------------------------------------
+        class affinity_partitioner {
+        	std::vector<int> workers_;
+        
+        	template<typename Range, typename Body> friend void parallel_for(const Range& range, const Body& body, affinity_partitioner& partitioner);
+        public:
+        	// pieces per worker, a few so that a stolen piece moves only a part of a worker's share
+        	static const int pieces_per_worker = 4;
+        
+        	// forgets the mapping, e.g. when the next loop runs over another range
+        	void clear() {
+        		workers_.clear();
+        	}
+        };
+        
+        template<typename Range, typename Body> class affinity_for_task : public parallel_for_task<Range, Body> {
+        	int& worker_;
+        public:
+        	affinity_for_task(const Range& range, const Body& body, int& worker) : parallel_for_task<Range, Body>(range, body), worker_(worker) {
+        	}
+        
+        	task* execute() override {
+        		worker_ = silk::current_worker_id;
+        
+        		return parallel_for_task<Range, Body>::execute();
+        	}
+        };
+        
+        // Halves range depth times in range order; the same range always yields the same pieces.
+        template<typename Range> void split_pieces(Range r, const int depth, std::vector<Range>& pieces) {
+        	if (depth == 0 || !r.is_divisible()) {
+        		pieces.push_back(r);
+        
+        		return;
+        	}
+        
+        	Range right(r, split());
+        
+        	split_pieces(r, depth - 1, pieces);
+        	split_pieces(right, depth - 1, pieces);
+        }
+        
+        // parallel_for that replays the piece-to-worker mapping of the previous call with the same partitioner.
+        template<typename Range, typename Body> void parallel_for(const Range& range, const Body& body, affinity_partitioner& partitioner) {
+        	if (range.empty())
+        		return;
+        
+        	int depth = 0;
+        
+        	for (int n = 1; n < silk::workers_count * affinity_partitioner::pieces_per_worker; n <<= 1) {
+        		depth++;
+        	}
+        
+        	std::vector<Range> pieces;
+        	split_pieces(range, depth, pieces);
+        
+        	std::vector<int>& workers = partitioner.workers_;
+        
+        	if (workers.size() != pieces.size()) {
+        		workers.assign(pieces.size(), -1);
+        	}
+        
+        	uwcontext* cx = fetch_current_uwcontext();
+        
+        	task* continuation_task = cx->continuation_task;
+        
+        	cx->continuation_task = nullptr;
+        
+        	empty_task* waiter = new empty_task();
+        
+        	waiter->set_ref_count(int(pieces.size()) + 1);
+        
+        	for (size_t i = 0; i < pieces.size(); i++) {
+        		const int worker = workers[i];
+        
+        		task& t = *new affinity_for_task<Range, Body>(pieces[i], body, workers[i]);
+        		t.set_continuation(*waiter);
+        
+        		if (worker >= 0) {
+        			spawn_mailbox(t, worker);
+        		} else {
+        			spawn(t);
+        		}
+        	}
+        
+        	cx->continuation_task = continuation_task;
+        
+        	wait_while([waiter]() { return waiter->ref_count() > 1; });
+        
+        	delete waiter;
+        }
+        
+        template<typename Value, typename Body> void parallel_for(Value begin, Value end, const Body& body, affinity_partitioner& partitioner) {
+        	parallel_for(blocked_range<Value>(begin, end), [&body](const blocked_range<Value>& r) {
+        		for (Value i = r.begin(); i != r.end(); ++i) {
+        			body(i);
+        		}
+        	}, partitioner);
+        }
+        
+        template<typename Value, typename Join> class reduce_join_task : public task {
+        	Value* result_;
+        	const Join& join_;
+        public:
+        	Value left;
+        	Value right;
+        
+        	reduce_join_task(Value* result, const Value& identity, const Join& join) : result_(result), join_(join), left(identity), right(identity) {
+        	}
+        
+        	task* execute() override {
+        		*result_ = join_(left, right);
+        
+        		return nullptr;
+        	}
+        };
+        
+        template<typename Range, typename Value, typename Body, typename Join> class parallel_reduce_task : public task {
+        	Range range_;
+        	Value* result_;
+        	const Value& identity_;
+        	const Body& body_;
+        	const Join& join_;
+        public:
+        	parallel_reduce_task(const Range& range, Value* result, const Value& identity, const Body& body, const Join& join) :
+        		range_(range), result_(result), identity_(identity), body_(body), join_(join) {
+        	}
+        
+        	task* execute() override {
+        		const int depth = split_depth(range_);
+        
+        		Value value = identity_;
+        
+        		range_stack<Range> pending(range_);
+        
+        		while (!pending.empty()) {
+        			if (pending.is_offloadable() && silk::is_work_demanded(silk::current_worker_id)) {
+        				// everything this task has done or still holds is left of the offloaded piece
+        				reduce_join_task<Value, Join>& j = *new(allocate_continuation()) reduce_join_task<Value, Join>(result_, identity_, join_);
+        				parallel_reduce_task& t = *new(j.allocate_child()) parallel_reduce_task(pending.pop_front(), &j.right, identity_, body_, join_);
+        				set_continuation(j);
+        				result_ = &j.left;
+        				j.set_ref_count(2);
+        				spawn(t);
+        
+        				continue;
+        			}
+        
+        			pending.split_back(depth);
+        
+        			value = body_(pending.back(), value);
+        
+        			pending.pop_back();
+        		}
+        
+        		*result_ = value;
+        
+        		return nullptr;
+        	}
+        };
+        
+        // Returns join over body(r, value) for disjoint pieces of range, in range order.
+        template<typename Range, typename Value, typename Body, typename Join> Value parallel_reduce(const Range& range, const Value& identity, const Body& body, const Join& join) {
+        	if (range.empty())
+        		return identity;
+        
+        	Value result = identity;
+        
+        	spawn_root_and_wait(*new parallel_reduce_task<Range, Value, Body, Join>(range, &result, identity, body, join));
+        
+        	return result;
+        }
+    }
+}
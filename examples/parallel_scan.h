@@ -0,0 +1,129 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <vector>
+#include "./parallel_for.h"
+
+namespace silk {
+    namespace demo_runtime_2 {
+        const size_t scan_block_size = 16384;
+        
+        inline size_t scan_blocks(const size_t n) {
+        	size_t blocks = size_t(silk::workers_count) * 8;
+        
+        	if (n / scan_block_size < blocks)
+        		blocks = n / scan_block_size;
+        
+        	return blocks ? blocks : 1;
+        }
+        
+        //---------------------------------------------------------
+        // Two-pass blocked scan: every block is reduced in parallel, the block
+        // sums are scanned serially, then every block is scanned in parallel
+        // starting from its offset. Both per-block loops are plain sequential
+        // loops over contiguous elements, so arithmetic types get vectorized
+        // reductions from the compiler.
+        //---------------------------------------------------------
+        template<typename InputIterator, typename OutputIterator, typename Value, typename BinaryOperation>
+        OutputIterator blocked_scan(InputIterator first, InputIterator last, OutputIterator d_first, const Value& init, const bool has_init, const bool is_inclusive, BinaryOperation op) {
+        	const size_t n = last - first;
+        
+        	if (n == 0)
+        		return d_first;
+        
+        	const size_t blocks = scan_blocks(n);
+        
+        	std::vector<Value> sums(blocks);
+        
+        	auto block_begin = [=](const size_t b) { return n * b / blocks; };
+        
+        	parallel_for(blocked_range<size_t>(0, blocks - 1), [&](const blocked_range<size_t>& r) {
+        		for (size_t b = r.begin(); b != r.end(); b++) {
+        			InputIterator i = first + block_begin(b);
+        			InputIterator e = first + block_begin(b + 1);
+        
+        			Value sum = *i;
+        
+        			for (++i; i != e; ++i) {
+        				sum = op(sum, *i);
+        			}
+        
+        			sums[b] = sum;
+        		}
+        	});
+        
+        	std::vector<Value> offsets(blocks);
+        	std::vector<bool> has_offset(blocks);
+        
+        	for (size_t b = 0; b < blocks; b++) {
+        		if (b == 0) {
+        			offsets[b] = init;
+        			has_offset[b] = has_init;
+        		} else {
+        			offsets[b] = has_offset[b - 1] ? op(offsets[b - 1], sums[b - 1]) : sums[b - 1];
+        			has_offset[b] = true;
+        		}
+        	}
+        
+        	parallel_for(blocked_range<size_t>(0, blocks), [&](const blocked_range<size_t>& r) {
+        		for (size_t b = r.begin(); b != r.end(); b++) {
+        			InputIterator i = first + block_begin(b);
+        			InputIterator e = first + block_begin(b + 1);
+        			OutputIterator o = d_first + block_begin(b);
+        
+        			Value acc = offsets[b];
+        
+        			if (is_inclusive) {
+        				if (!has_offset[b]) {
+        					acc = *i;
+        					*o = acc;
+        					++i;
+        					++o;
+        				}
+        
+        				for (; i != e; ++i, ++o) {
+        					acc = op(acc, *i);
+        					*o = acc;
+        				}
+        			} else {
+        				for (; i != e; ++i, ++o) {
+        					Value v = *i;
+        					*o = acc;
+        					acc = op(acc, v);
+        				}
+        			}
+        		}
+        	});
+        
+        	return d_first + n;
+        }
+        
+        template<typename InputIterator, typename OutputIterator, typename BinaryOperation>
+        OutputIterator parallel_inclusive_scan(InputIterator first, InputIterator last, OutputIterator d_first, BinaryOperation op) {
+        	typedef typename std::iterator_traits<InputIterator>::value_type value_type;
+        
+        	return blocked_scan(first, last, d_first, value_type(), false, true, op);
+        }
+        
+        template<typename InputIterator, typename OutputIterator, typename BinaryOperation, typename Value>
+        OutputIterator parallel_inclusive_scan(InputIterator first, InputIterator last, OutputIterator d_first, BinaryOperation op, Value init) {
+        	return blocked_scan(first, last, d_first, init, true, true, op);
+        }
+        
+        template<typename InputIterator, typename OutputIterator>
+        OutputIterator parallel_inclusive_scan(InputIterator first, InputIterator last, OutputIterator d_first) {
+        	return parallel_inclusive_scan(first, last, d_first, std::plus<typename std::iterator_traits<InputIterator>::value_type>());
+        }
+        
+        template<typename InputIterator, typename OutputIterator, typename Value, typename BinaryOperation>
+        OutputIterator parallel_exclusive_scan(InputIterator first, InputIterator last, OutputIterator d_first, Value init, BinaryOperation op) {
+        	return blocked_scan(first, last, d_first, init, true, false, op);
+        }
+        
+        template<typename InputIterator, typename OutputIterator, typename Value>
+        OutputIterator parallel_exclusive_scan(InputIterator first, InputIterator last, OutputIterator d_first, Value init) {
+        	return parallel_exclusive_scan(first, last, d_first, init, std::plus<Value>());
+        }
+    }
+}
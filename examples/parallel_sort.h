@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include "./taskruntime2.h"
+
+namespace silk {
+    namespace demo_runtime_2 {
+        const size_t sort_cutoff = 2048;
+        const size_t merge_cutoff = 8192;
+        
+        // Merges [first1, last1) and [first2, last2) into out, splitting the larger
+        // input at its middle and the other one at the matching lower_bound.
+        template<typename InputIterator, typename OutputIterator, typename Compare> class merge_task : public task {
+        	InputIterator first1_;
+        	InputIterator last1_;
+        	InputIterator first2_;
+        	InputIterator last2_;
+        	OutputIterator out_;
+        	Compare comp_;
+        public:
+        	merge_task(InputIterator first1, InputIterator last1, InputIterator first2, InputIterator last2, OutputIterator out, Compare comp) :
+        		first1_(first1), last1_(last1), first2_(first2), last2_(last2), out_(out), comp_(comp) {
+        	}
+        
+        	task* execute() override {
+        		size_t n1 = last1_ - first1_;
+        		size_t n2 = last2_ - first2_;
+        
+        		if (n1 + n2 <= merge_cutoff) {
+        			std::merge(std::make_move_iterator(first1_), std::make_move_iterator(last1_), std::make_move_iterator(first2_), std::make_move_iterator(last2_), out_, comp_);
+        
+        			return nullptr;
+        		}
+        
+        		if (n1 < n2) {
+        			std::swap(first1_, first2_);
+        			std::swap(last1_, last2_);
+        			std::swap(n1, n2);
+        		}
+        
+        		InputIterator middle1 = first1_ + n1 / 2;
+        		InputIterator middle2 = std::lower_bound(first2_, last2_, *middle1, comp_);
+        
+        		empty_task& c = *new(allocate_continuation()) empty_task();
+        		merge_task& left = *new(c.allocate_child()) merge_task(first1_, middle1, first2_, middle2, out_, comp_);
+        		merge_task& right = *new(c.allocate_child()) merge_task(middle1, last1_, middle2, last2_, out_ + (middle1 - first1_) + (middle2 - first2_), comp_);
+        		c.set_ref_count(2);
+        		spawn(right);
+        
+        		return &left;
+        	}
+        };
+        
+        // Sorts n elements at first. The result ends up at first, or at buffer when
+        // to_buffer is set; children alternate, so the root's final merge writes
+        // straight into the input and nothing is copied back.
+        template<typename RandomIterator, typename Compare> class sort_task : public task {
+        	typedef typename std::iterator_traits<RandomIterator>::value_type value_type;
+        
+        	RandomIterator first_;
+        	value_type* buffer_;
+        	size_t n_;
+        	bool to_buffer_;
+        	Compare comp_;
+        
+        	template<typename Merge> task* split(Merge& c) {
+        		const size_t m = n_ / 2;
+        
+        		sort_task& left = *new(c.allocate_child()) sort_task(first_, buffer_, m, !to_buffer_, comp_);
+        		sort_task& right = *new(c.allocate_child()) sort_task(first_ + m, buffer_ + m, n_ - m, !to_buffer_, comp_);
+        		c.set_ref_count(2);
+        		spawn(right);
+        
+        		return &left;
+        	}
+        public:
+        	sort_task(RandomIterator first, value_type* buffer, const size_t n, const bool to_buffer, Compare comp) :
+        		first_(first), buffer_(buffer), n_(n), to_buffer_(to_buffer), comp_(comp) {
+        	}
+        
+        	task* execute() override {
+        		if (n_ <= sort_cutoff) {
+        			std::sort(first_, first_ + n_, comp_);
+        
+        			if (to_buffer_) {
+        				std::move(first_, first_ + n_, buffer_);
+        			}
+        
+        			return nullptr;
+        		}
+        
+        		const size_t m = n_ / 2;
+        
+        		if (to_buffer_) {
+        			return split(*new(allocate_continuation()) merge_task<RandomIterator, value_type*, Compare>(first_, first_ + m, first_ + m, first_ + n_, buffer_, comp_));
+        		}
+        
+        		return split(*new(allocate_continuation()) merge_task<value_type*, RandomIterator, Compare>(buffer_, buffer_ + m, buffer_ + m, buffer_ + n_, first_, comp_));
+        	}
+        };
+        
+        // Parallel merge sort, not stable. Needs a temporary buffer of n default-constructible elements.
+        template<typename RandomIterator, typename Compare> void parallel_sort(RandomIterator first, RandomIterator last, Compare comp) {
+        	typedef typename std::iterator_traits<RandomIterator>::value_type value_type;
+        
+        	const size_t n = last - first;
+        
+        	if (n <= sort_cutoff) {
+        		std::sort(first, last, comp);
+        
+        		return;
+        	}
+        
+        	std::vector<value_type> buffer(n);
+        
+        	spawn_root_and_wait(*new sort_task<RandomIterator, Compare>(first, buffer.data(), n, false, comp));
+        }
+        
+        template<typename RandomIterator> void parallel_sort(RandomIterator first, RandomIterator last) {
+        	parallel_sort(first, last, std::less<typename std::iterator_traits<RandomIterator>::value_type>());
+        }
+    }
+}
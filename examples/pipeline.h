@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vector>
+#include "./taskruntime2.h"
+
+namespace silk {
+    namespace demo_runtime_2 {
+        enum filter_mode { serial_in_order, serial_out_of_order, parallel };
+        
+        class pipeline;
+        class pipeline_task;
+        
+        //---------------------------------------------------------
+        // One stage of a pipeline. The first filter is the input: it is
+        // called with nullptr and returns the next item or nullptr when the
+        // input is over, it is always executed serially. Other filters get
+        // the item returned by the previous filter and must return an item;
+        // what the last filter returns is ignored.
+        //---------------------------------------------------------
+        class filter {
+        	friend class pipeline;
+        	friend class pipeline_task;
+        
+        	filter_mode mode_;
+        	silk::spin_lock sync_;
+        	bool is_busy_;
+        	size_t next_token_;
+        	std::vector<pipeline_task*> in_order_waiting_;
+        	pipeline_task* out_of_order_waiting_;
+        
+        	void reset(const size_t max_tokens) {
+        		is_busy_ = false;
+        		next_token_ = 0;
+        		in_order_waiting_.assign(max_tokens, nullptr);
+        		out_of_order_waiting_ = nullptr;
+        	}
+        
+        	bool try_admit(pipeline_task* t);
+        
+        	pipeline_task* release(const size_t token);
+        public:
+        	filter(const filter_mode mode) : mode_(mode) {
+        	}
+        
+        	virtual ~filter() {
+        	}
+        
+        	filter_mode mode() const {
+        		return mode_;
+        	}
+        
+        	virtual void* operator()(void* item) = 0;
+        };
+        
+        //---------------------------------------------------------
+        // Items flow through the filters as tasks; at most max_tokens items
+        // are in flight, when they are all taken the input stalls until an
+        // item leaves the last filter. A task carries its item through every
+        // stage on the same worker and only parks at a busy serial filter.
+        //---------------------------------------------------------
+        class pipeline {
+        	friend class pipeline_task;
+        
+        	std::vector<filter*> filters_;
+        	silk::spin_lock sync_;
+        	size_t free_tokens_;
+        	size_t input_token_;
+        	bool is_input_active_;
+        	bool is_input_done_;
+        
+        	void pass_input(task& t);
+        
+        	void finish_input();
+        
+        	bool release_token();
+        public:
+        	void add_filter(filter& f) {
+        		filters_.push_back(&f);
+        	}
+        
+        	void clear() {
+        		filters_.clear();
+        	}
+        
+        	// Blocks (executing other tasks) until the input filter returns nullptr and every item has left the pipeline.
+        	void run(const size_t max_tokens);
+        };
+        
+        class pipeline_task : public task {
+        	friend class filter;
+        
+        	pipeline& pipeline_;
+        	size_t stage_ = 0;
+        	size_t token_ = 0;
+        	void* item_ = nullptr;
+        	bool is_admitted_ = false;
+        	pipeline_task* next_waiting_ = nullptr;
+        public:
+        	pipeline_task(pipeline& p) : pipeline_(p) {
+        	}
+        
+        	task* execute() override {
+        		const size_t stages = pipeline_.filters_.size();
+        
+        		while (1) {
+        			if (stage_ == 0) {
+        				// only one task at a time holds the input, together with a free token
+        				item_ = (*pipeline_.filters_[0])(nullptr);
+        
+        				if (!item_) {
+        					pipeline_.finish_input();
+        
+        					return nullptr;
+        				}
+        
+        				token_ = pipeline_.input_token_++;
+        				stage_ = 1;
+        
+        				pipeline_.pass_input(*this);
+        
+        				continue;
+        			}
+        
+        			if (stage_ == stages) {
+        				if (pipeline_.release_token()) {
+        					// the input was stalled waiting for this token, read the next item here
+        					stage_ = 0;
+        
+        					continue;
+        				}
+        
+        				return nullptr;
+        			}
+        
+        			filter& f = *pipeline_.filters_[stage_];
+        
+        			if (f.mode_ != parallel) {
+        				if (!is_admitted_ && !f.try_admit(this)) {
+        					// parked, the task releasing the filter spawns this one again
+        					recycle();
+        
+        					return nullptr;
+        				}
+        
+        				is_admitted_ = false;
+        
+        				item_ = f(item_);
+        
+        				if (pipeline_task* next = f.release(token_)) {
+        					spawn(*next);
+        				}
+        			} else {
+        				item_ = f(item_);
+        			}
+        
+        			stage_++;
+        		}
+        	}
+        };
+        
+        inline bool filter::try_admit(pipeline_task* t) {
+        	sync_.lock();
+        
+        	if (!is_busy_ && (mode_ == serial_out_of_order || t->token_ == next_token_)) {
+        		is_busy_ = true;
+        		sync_.unlock();
+        
+        		return true;
+        	}
+        
+        	if (mode_ == serial_in_order) {
+        		in_order_waiting_[t->token_ % in_order_waiting_.size()] = t;
+        	} else {
+        		t->next_waiting_ = out_of_order_waiting_;
+        		out_of_order_waiting_ = t;
+        	}
+        
+        	sync_.unlock();
+        
+        	return false;
+        }
+        
+        // Hands the filter to the next waiting task, if any; the filter stays busy for it.
+        inline pipeline_task* filter::release(const size_t token) {
+        	pipeline_task* next;
+        
+        	sync_.lock();
+        
+        	if (mode_ == serial_in_order) {
+        		next_token_ = token + 1;
+        
+        		pipeline_task*& slot = in_order_waiting_[next_token_ % in_order_waiting_.size()];
+        		next = slot;
+        		slot = nullptr;
+        	} else {
+        		next = out_of_order_waiting_;
+        
+        		if (next) {
+        			out_of_order_waiting_ = next->next_waiting_;
+        		}
+        	}
+        
+        	if (next) {
+        		next->is_admitted_ = true;
+        	} else {
+        		is_busy_ = false;
+        	}
+        
+        	sync_.unlock();
+        
+        	return next;
+        }
+        
+        // Called by the input holder after it has read an item: the input moves to a new task if a token is free.
+        inline void pipeline::pass_input(task& t) {
+        	sync_.lock();
+        
+        	const bool has_token = !is_input_done_ && free_tokens_ > 0;
+        
+        	if (has_token) {
+        		free_tokens_--;
+        	} else {
+        		is_input_active_ = false;
+        	}
+        
+        	sync_.unlock();
+        
+        	if (has_token) {
+        		task* c = t.continuation();
+        		c->increment_ref_count();
+        
+        		pipeline_task& input = *new pipeline_task(*this);
+        		input.set_continuation(*c);
+        		spawn(input);
+        	}
+        }
+        
+        inline void pipeline::finish_input() {
+        	sync_.lock();
+        
+        	is_input_done_ = true;
+        	is_input_active_ = false;
+        	free_tokens_++;
+        
+        	sync_.unlock();
+        }
+        
+        // Returns true when the caller keeps its token to restart the stalled input.
+        inline bool pipeline::release_token() {
+        	sync_.lock();
+        
+        	const bool is_input_stalled = !is_input_done_ && !is_input_active_;
+        
+        	if (is_input_stalled) {
+        		is_input_active_ = true;
+        	} else {
+        		free_tokens_++;
+        	}
+        
+        	sync_.unlock();
+        
+        	return is_input_stalled;
+        }
+        
+        inline void pipeline::run(const size_t max_tokens) {
+        	if (filters_.empty() || max_tokens == 0)
+        		return;
+        
+        	for (filter* f : filters_) {
+        		f->reset(max_tokens);
+        	}
+        
+        	free_tokens_ = max_tokens - 1;
+        	input_token_ = 0;
+        	is_input_active_ = true;
+        	is_input_done_ = false;
+        
+        	spawn_root_and_wait(*new pipeline_task(*this));
+        }
+    }
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "./taskruntime2.h"
+
+namespace silk {
+    namespace demo_runtime_2 {
+        class task_graph;
+        class graph_node;
+        
+        // Task of a graph node. It is allocated once with its node and recycled
+        // on every execution, so running a graph again allocates nothing.
+        class graph_node_task : public task {
+        	graph_node& node_;
+        public:
+        	graph_node_task(graph_node& node) : node_(node) {
+        	}
+        
+        	task* execute() override;
+        };
+        
+        class graph_node {
+        	friend class task_graph;
+        	friend class graph_node_task;
+        
+        	task_graph& graph_;
+        	graph_node_task task_;
+        	std::vector<graph_node*> successors_;
+        	int predecessors_count_ = 0;
+        	std::atomic<int> pending_predecessors_count_;
+        	int cost_;
+        	int priority_ = 0;
+        protected:
+        	graph_node(task_graph& graph, const int cost) : graph_(graph), task_(*this), cost_(cost) {
+        	}
+        
+        	virtual void invoke() = 0;
+        public:
+        	virtual ~graph_node() {
+        	}
+        
+        	// s runs after this node is done
+        	void precede(graph_node& s);
+        
+        	void succeed(graph_node& p) {
+        		p.precede(*this);
+        	}
+        
+        	// length of the costliest path from this node to a sink, including its own cost
+        	int priority() const {
+        		return priority_;
+        	}
+        };
+        
+        template<typename F> class function_graph_node : public graph_node {
+        	F body_;
+        protected:
+        	void invoke() override {
+        		body_();
+        	}
+        public:
+        	function_graph_node(task_graph& graph, F body, const int cost) : graph_node(graph, cost), body_(std::move(body)) {
+        	}
+        };
+        
+        //---------------------------------------------------------
+        // DAG of nodes executed with successor counting: every node keeps the
+        // number of predecessors not done yet, the predecessor finishing last
+        // makes it ready. One ready successor is returned from execute() as a
+        // bypass so a chain stays on the worker that produced its input, the
+        // others are spawned. With critical_path_first the bypassed successor
+        // is the one with the costliest path to a sink.
+        //---------------------------------------------------------
+        class task_graph {
+        	friend class graph_node;
+        	friend class graph_node_task;
+        
+        	std::vector<graph_node*> nodes_;
+        	std::vector<graph_node*> sources_;
+        	std::vector<graph_node*> prioritized_sources_;
+        	std::atomic<size_t> pending_nodes_count_;
+        	bool is_critical_path_first_ = false;
+        	bool is_topology_changed_ = true;
+        
+        	void prepare() {
+        		sources_.clear();
+        
+        		std::vector<graph_node*> order;
+        		order.reserve(nodes_.size());
+        
+        		for (graph_node* n : nodes_) {
+        			n->pending_predecessors_count_.store(n->predecessors_count_, std::memory_order_relaxed);
+        
+        			if (n->predecessors_count_ == 0) {
+        				sources_.push_back(n);
+        				order.push_back(n);
+        			}
+        		}
+        
+        		for (size_t i = 0; i < order.size(); i++) {
+        			for (graph_node* s : order[i]->successors_) {
+        				if (s->pending_predecessors_count_.fetch_sub(1, std::memory_order_relaxed) == 1) {
+        					order.push_back(s);
+        				}
+        			}
+        		}
+        
+        		assert(order.size() == nodes_.size() && "task_graph has a cycle");
+        
+        		for (size_t i = order.size(); i-- > 0;) {
+        			graph_node* n = order[i];
+        			int longest = 0;
+        
+        			for (graph_node* s : n->successors_) {
+        				longest = std::max(longest, s->priority_);
+        			}
+        
+        			n->priority_ = n->cost_ + longest;
+        		}
+        
+        		prioritized_sources_ = sources_;
+        
+        		std::sort(prioritized_sources_.begin(), prioritized_sources_.end(), [](const graph_node* a, const graph_node* b) { return a->priority_ < b->priority_; });
+        
+        		is_topology_changed_ = false;
+        	}
+        public:
+        	task_graph() {
+        	}
+        
+        	task_graph(const task_graph&) = delete;
+        
+        	task_graph& operator=(const task_graph&) = delete;
+        
+        	~task_graph() {
+        		for (graph_node* n : nodes_) {
+        			delete n;
+        		}
+        	}
+        
+        	// cost is the weight of the node for critical_path_first ordering
+        	template<typename F> graph_node& emplace(F&& body, const int cost = 1) {
+        		graph_node* n = new function_graph_node<typename std::decay<F>::type>(*this, std::forward<F>(body), cost);
+        		nodes_.push_back(n);
+        		is_topology_changed_ = true;
+        		return *n;
+        	}
+        
+        	size_t size() const {
+        		return nodes_.size();
+        	}
+        
+        	// Executes every node once, after all its predecessors. Blocks (executing
+        	// other tasks) until the graph is done; can be called again and again.
+        	void run(const bool critical_path_first = false) {
+        		if (nodes_.empty())
+        			return;
+        
+        		if (is_topology_changed_) {
+        			prepare();
+        		}
+        
+        		for (graph_node* n : nodes_) {
+        			n->pending_predecessors_count_.store(n->predecessors_count_, std::memory_order_relaxed);
+        		}
+        
+        		is_critical_path_first_ = critical_path_first;
+        		pending_nodes_count_.store(nodes_.size(), std::memory_order_release);
+        
+        		// the deque is LIFO for its owner: the last spawned source runs first
+        		for (graph_node* n : critical_path_first ? prioritized_sources_ : sources_) {
+        			spawn(n->task_);
+        		}
+        
+        		wait_while([this]() { return pending_nodes_count_.load(std::memory_order_acquire) > 0; });
+        	}
+        };
+        
+        inline void graph_node::precede(graph_node& s) {
+        	successors_.push_back(&s);
+        	s.predecessors_count_++;
+        	graph_.is_topology_changed_ = true;
+        }
+        
+        inline task* graph_node_task::execute() {
+        	node_.invoke();
+        
+        	// the task belongs to the node, schedule must not delete it
+        	recycle();
+        
+        	task_graph& g = node_.graph_;
+        
+        	graph_node* bypass = nullptr;
+        
+        	for (graph_node* s : node_.successors_) {
+        		if (s->pending_predecessors_count_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        			continue;
+        
+        		if (!bypass) {
+        			bypass = s;
+        		} else if (g.is_critical_path_first_ && bypass->priority_ < s->priority_) {
+        			spawn(bypass->task_);
+        			bypass = s;
+        		} else {
+        			spawn(s->task_);
+        		}
+        	}
+        
+        	g.pending_nodes_count_.fetch_sub(1, std::memory_order_acq_rel);
+        
+        	return bypass ? &bypass->task_ : nullptr;
+        }
+    }
+}
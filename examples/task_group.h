@@ -0,0 +1,97 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include "./taskruntime2.h"
+
+namespace silk {
+    namespace demo_runtime_2 {
+        class task_group;
+        
+        template<typename F> class task_group_task : public task {
+        	task_group& group_;
+        	F body_;
+        public:
+        	task_group_task(task_group& group, F body) : group_(group), body_(std::move(body)) {
+        	}
+        
+        	task* execute() override;
+        };
+        
+        //---------------------------------------------------------
+        // Fork-join without continuations: run() spawns a function, wait()
+        // returns once every function run in the group is done. The waiting
+        // thread executes pool tasks in the meantime instead of blocking, so
+        // groups nest (a request handler can wait for its own parallel work
+        // from inside a task). wait(true) is isolated: the waiter executes
+        // only tasks of this group and tasks they create, a long unrelated
+        // task can not get on its stack and delay the return from wait().
+        //---------------------------------------------------------
+        class task_group {
+        	template<typename F> friend class task_group_task;
+        
+        	isolation_region region_;
+        	std::atomic<long> pending_count_;
+        
+        	void done() {
+        		pending_count_.fetch_sub(1, std::memory_order_release);
+        	}
+        public:
+        	task_group() : pending_count_(0) {
+        		region_.parent = fetch_current_uwcontext()->current_isolation;
+        	}
+        
+        	task_group(const task_group&) = delete;
+        
+        	task_group& operator=(const task_group&) = delete;
+        
+        	~task_group() {
+        		wait();
+        	}
+        
+        	template<typename F> void run(F&& f) {
+        		uwcontext* cx = fetch_current_uwcontext();
+        
+        		task* continuation_task = cx->continuation_task;
+        
+        		cx->continuation_task = nullptr;
+        
+        		task& t = *new task_group_task<typename std::decay<F>::type>(*this, std::forward<F>(f));
+        
+        		cx->continuation_task = continuation_task;
+        
+        		t.set_isolation(&region_);
+        
+        		pending_count_.fetch_add(1, std::memory_order_relaxed);
+        
+        		spawn(t);
+        	}
+        
+        	// Executes pool tasks (only tasks of this group when isolated) until the group is done.
+        	void wait(const bool isolated = false) {
+        		auto is_pending = [this]() { return pending_count_.load(std::memory_order_acquire) > 0; };
+        
+        		if (!is_pending())
+        			return;
+        
+        		if (isolated) {
+        			wait_while_isolated(region_, is_pending);
+        		} else {
+        			wait_while(is_pending);
+        		}
+        	}
+        
+        	bool is_done() const {
+        		return pending_count_.load(std::memory_order_acquire) == 0;
+        	}
+        };
+        
+        template<typename F> task* task_group_task<F>::execute() {
+        	body_();
+        
+        	group_.done();
+        
+        	return nullptr;
+        }
+    }
+}
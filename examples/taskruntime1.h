@@ -1,18 +1,100 @@
 #pragma once
 
 #include "./../src/silk_pool.h"
-#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef SILK_FUNC_INLINE_SIZE
+#define SILK_FUNC_INLINE_SIZE 48
+#endif
 
 namespace silk {
     namespace demo_runtime_1 {
+        struct func_pool;
+        
         struct func : silk::task {
-        	std::function<void()>* func;
+        	void (*invoke)(func*);
+        	void* callable;
+        	func_pool* owner;
+        	alignas(std::max_align_t) char storage[SILK_FUNC_INLINE_SIZE];
+        };
+        
+        // Nodes allocated by a thread go back to that thread: freed there onto free, freed by another thread
+        // (a worker runs what the main thread spawned) onto returned, which the owner takes back in one go
+        // once free runs dry. So a thread never holds more nodes than it has had in flight at once.
+        struct func_pool {
+        	func* free = nullptr;
+        	std::atomic<func*> returned { nullptr };
         };
         
-        inline void spawn(std::function<void()> t) {
-        	func* f = new func();
+        // never deleted, nodes of a thread may be freed after it has exited
+        thread_local func_pool* local_funcs = nullptr;
+        
+        inline func* allocate_func() {
+        	if (!local_funcs) {
+        		local_funcs = new func_pool();
+        	}
+        
+        	func_pool* p = local_funcs;
+        
+        	func* f = p->free;
+        
+        	if (!f && p->returned.load(std::memory_order_relaxed)) {
+        		f = p->returned.exchange(nullptr, std::memory_order_acquire);
+        	}
+        
+        	if (!f) {
+        		f = new func();
+        		f->owner = p;
+        
+        		return f;
+        	}
+        
+        	p->free = (func*) f->next;
         
-        	f->func = new std::function<void()>(t);
+        	return f;
+        }
+        
+        inline void free_func(func* f) {
+        	func_pool* p = f->owner;
+        
+        	if (p == local_funcs) {
+        		f->next = p->free;
+        		p->free = f;
+        
+        		return;
+        	}
+        
+        	func* head = p->returned.load(std::memory_order_relaxed);
+        
+        	do {
+        		f->next = head;
+        	} while (!p->returned.compare_exchange_weak(head, f, std::memory_order_release, std::memory_order_relaxed));
+        }
+        
+        template<typename F> inline void spawn(F&& t) {
+        	typedef typename std::decay<F>::type callable;
+        
+        	func* f = allocate_func();
+        
+        	if constexpr (sizeof(callable) <= SILK_FUNC_INLINE_SIZE && alignof(callable) <= alignof(std::max_align_t)) {
+        		f->callable = new (f->storage) callable(std::forward<F>(t));
+        		f->invoke = [](func* f) {
+        			callable* c = (callable*) f->callable;
+        			(*c)();
+        			c->~callable();
+        		};
+        	} else {
+        		f->callable = new callable(std::forward<F>(t));
+        		f->invoke = [](func* f) {
+        			callable* c = (callable*) f->callable;
+        			(*c)();
+        			delete c;
+        		};
+        	}
         
         	silk::spawn(silk::current_worker_id, (silk::task*) f);
 		}
@@ -20,15 +102,11 @@ namespace silk {
         #define spawn2( ex ) spawn([=]() { ex; })
         
         void schedule(silk::task* t) {
-        	func* func_container = (func*)t;
-        	
-        	std::function<void()>* f = func_container->func;
-        	
-        	(*f)();
-        	
-        	delete f;
-        
-        	delete t;
+        	func* f = (func*)t;
+        
+        	f->invoke(f);
+        
+        	free_func(f);
 		}
     }
 }
\ No newline at end of file
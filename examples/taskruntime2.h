@@ -4,21 +4,39 @@
 #include <sys/event.h>
 #include <unistd.h>
 #include "./../src/silk_pool.h"
+#include "./../src/silk_blocking.h"
     
 namespace silk {
     namespace demo_runtime_2 {
         class task;
         
+        // Tasks created while a task of a region runs belong to the region too, see wait_while_isolated.
+        struct isolation_region {
+        	const isolation_region* parent;
+        
+        	// true when r is this region or nested in it
+        	bool contains(const isolation_region* r) const {
+        		for (; r; r = r->parent) {
+        			if (r == this)
+        				return true;
+        		}
+        
+        		return false;
+        	}
+        };
+        
         struct uwcontext : public silk::wcontext {
         	bool is_recyclable;
         	task* continuation_task;
         	task* current_executable_task;
+        	const isolation_region* current_isolation;
         };
         
         silk::wcontext* makeuwcontext() {
         	uwcontext* c = new uwcontext();
         	silk::init_wcontext(c);
         	c->current_executable_task = c->continuation_task = nullptr;
+        	c->current_isolation = nullptr;
         	return c;
         }
         
@@ -52,11 +70,13 @@ namespace silk {
         	task* continuation_;
         	std::atomic<int> ref_count_ = 0;
         	cancellation_token* cancellation_token_ = nullptr;
+        	const isolation_region* isolation_;
         public:
         	task() {
         		auto c = fetch_current_uwcontext();
         		continuation_ = c->continuation_task ? c->continuation_task : nullptr;
         		c->continuation_task = nullptr;
+        		isolation_ = c->current_isolation;
         	}
         
         	virtual ~task() {
@@ -130,6 +150,14 @@ namespace silk {
         		return cancellation_token_;
         	}
         
+        	const isolation_region* isolation() const {
+        		return isolation_;
+        	}
+        
+        	void set_isolation(const isolation_region* r) {
+        		isolation_ = r;
+        	}
+        
         	static task* self() {
         		return fetch_current_uwcontext()->current_executable_task;
         	};
@@ -165,9 +193,12 @@ namespace silk {
         
         	task* c = nullptr;
         
+        	const isolation_region* current_isolation = cx->current_isolation;
+        
         	do {
         		if (!t->is_canceled()) {
         			cx->current_executable_task = t;
+        			cx->current_isolation = t->isolation();
         			cx->is_recyclable = false;
         
         			task* bypass = t->execute();
@@ -193,15 +224,167 @@ namespace silk {
         			delete t;
         		}
         
-        		t = c && c->decrement_ref_count() <= 0 ? c : nullptr;
+        		t = c && c->decrement_ref_count(std::memory_order_acq_rel) <= 0 ? c : nullptr;
         		c = nullptr;
         	} while (t);
+        
+        	cx->current_isolation = current_isolation;
         }
         
+        // Runs t and what it continues into on the calling thread, inside the running task.
+        inline void execute_inline(task& t) {
+        	uwcontext* cx = fetch_current_uwcontext();
+        
+        	task* current_executable_task = cx->current_executable_task;
+        	task* continuation_task = cx->continuation_task;
+        	bool is_recyclable = cx->is_recyclable;
+        
+        	cx->continuation_task = nullptr;
+        	cx->inline_depth++;
+        
+        	schedule(&t);
+        
+        	cx->inline_depth--;
+        	cx->current_executable_task = current_executable_task;
+        	cx->continuation_task = continuation_task;
+        	cx->is_recyclable = is_recyclable;
+        }
+        
+        // Queues t, or runs it inline when the deque of the worker is full, see silk::set_spawn_limits.
         inline void spawn(task& t) {
+        	if (silk::is_spawn_throttled(silk::current_worker_id)) {
+        		execute_inline(t);
+        
+        		return;
+        	}
+        
         	silk::spawn(silk::current_worker_id, (task*)&t);
         }
         
+        // spawn with a preference for worker_id, see silk::spawn_mailbox
+        inline void spawn_mailbox(task& t, const int worker_id) {
+        	silk::spawn_mailbox(worker_id, (task*)&t);
+        }
+        
+        // spawn to be started by deadline, earliest deadline first, see silk::set_deadline_mode
+        inline void spawn_deadline(task& t, const std::chrono::steady_clock::time_point deadline) {
+        	silk::spawn_deadline(silk::current_worker_id, (task*)&t, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count());
+        }
+        
+        class empty_task : public task {
+        public:
+        	task* execute() {
+        		return nullptr;
+        	}
+        };
+        
+        // Executes pool tasks on the calling thread while is_pending() returns true.
+        // Safe to call from inside execute().
+        template<typename Predicate> void wait_while(Predicate is_pending) {
+        	uwcontext* cx = fetch_current_uwcontext();
+        
+        	task* current_executable_task = cx->current_executable_task;
+        	task* continuation_task = cx->continuation_task;
+        	bool is_recyclable = cx->is_recyclable;
+        
+        	cx->continuation_task = nullptr;
+        
+        	silk::join_pool_while(schedule, is_pending);
+        
+        	cx->current_executable_task = current_executable_task;
+        	cx->continuation_task = continuation_task;
+        	cx->is_recyclable = is_recyclable;
+        }
+        
+        // wait_while that executes only tasks of region (and of regions nested in it), so the calling
+        // task can not pick up unrelated work and has to finish it before it returns.
+        template<typename Predicate> void wait_while_isolated(const isolation_region& region, Predicate is_pending) {
+        	uwcontext* cx = fetch_current_uwcontext();
+        
+        	task* current_executable_task = cx->current_executable_task;
+        	task* continuation_task = cx->continuation_task;
+        	bool is_recyclable = cx->is_recyclable;
+        
+        	cx->continuation_task = nullptr;
+        
+        	silk::join_pool_while_accepting(schedule, is_pending, [&region](silk::task* t) { return region.contains(((task*)t)->isolation()); });
+        
+        	cx->current_executable_task = current_executable_task;
+        	cx->continuation_task = continuation_task;
+        	cx->is_recyclable = is_recyclable;
+        }
+        
+        // Spawns t and executes pool tasks on the calling thread until t and all
+        // tasks that continue into it are done. Safe to call from inside execute().
+        inline void spawn_root_and_wait(task& t) {
+        	uwcontext* cx = fetch_current_uwcontext();
+        
+        	task* continuation_task = cx->continuation_task;
+        
+        	cx->continuation_task = nullptr;
+        
+        	empty_task* waiter = new empty_task();
+        
+        	cx->continuation_task = continuation_task;
+        
+        	waiter->set_ref_count(2);
+        	t.set_continuation(*waiter);
+        
+        	spawn(t);
+        
+        	wait_while([waiter]() { return waiter->ref_count() > 1; });
+        
+        	delete waiter;
+        }
+        
+        // Runs fn on the blocking pool, not on a worker. Then continuation is released like by a finished
+        // child (its ref count is decremented, at 0 it runs), preferably on the worker that called spawn_blocking.
+        template<typename F> void spawn_blocking(F fn, task& continuation) {
+        	const int worker_id = silk::current_worker_id;
+        	task* c = &continuation;
+        
+        	silk::run_blocking([fn, c, worker_id]() mutable {
+        		fn();
+        
+        		if (c->decrement_ref_count(std::memory_order_acq_rel) <= 0) {
+        			silk::spawn_mailbox(worker_id, (silk::task*) c);
+        		}
+        	});
+        }
+        
+        // silk::blocking_region inside execute(): the stand-in thread runs tasks in the context of this
+        // worker, so the state of the running task is put back when the region ends.
+        class blocking_region {
+        	uwcontext* cx_;
+        	task* current_executable_task_;
+        	task* continuation_task_;
+        	bool is_recyclable_;
+        	const isolation_region* current_isolation_;
+        	silk::blocking_region region_;
+        public:
+        	blocking_region() : cx_(silk::is_worker_thread ? fetch_current_uwcontext() : nullptr) {
+        		if (cx_) {
+        			current_executable_task_ = cx_->current_executable_task;
+        			continuation_task_ = cx_->continuation_task;
+        			is_recyclable_ = cx_->is_recyclable;
+        			current_isolation_ = cx_->current_isolation;
+        		}
+        	}
+        
+        	blocking_region(const blocking_region&) = delete;
+        
+        	~blocking_region() {
+        		region_.leave();
+        
+        		if (cx_) {
+        			cx_->current_executable_task = current_executable_task_;
+        			cx_->continuation_task = continuation_task_;
+        			cx_->is_recyclable = is_recyclable_;
+        			cx_->current_isolation = current_isolation_;
+        		}
+        	}
+        };
+        
         int kq;
         
         typedef void(*readed_callback)(const int socket, char* buf, const int nbytes);
@@ -1,6 +1,8 @@
 #include "./../src/silk_pool.h"
-#include <ucontext.h>
-#include <functional>
+#include "./../src/silk_context.h"
+#include "./../src/silk_stack.h"
+#include <new>
+#include <stdio.h>
 #include <sys/types.h>
 #include <sys/event.h>
 #include <unistd.h>
@@ -9,24 +11,44 @@
 
 namespace silk {
     namespace demo_runtime_3_1 {
+        struct coro_frame;
+        
+        typedef struct io_read_frame_t {
+            coro_frame* coro_frame;
+            int nbytes;
+            char* buf;
+            int n;
+        } io_read_frame;
+        
+        // what the scheduler has to do once the coroutine is switched out
+        enum after_yield_operation { nothing, wait_readable };
+        
+        struct after_yield_action {
+            after_yield_operation operation;
+            int socket;
+            void* udata;
+        };
+        
         struct coro_frame : silk::task {
-            std::function<void()> after_yield;
+            after_yield_action after_yield;
+            io_read_frame read_frame;
             int read_sequence_count;
             bool is_suspended;
-            ucontext_t* coro;
-            int stack_size;
-            char* stack;
+            silk::coro_context coro;
+            silk::stack* stack;
         };
         
         struct uwcontext : silk::wcontext {
             coro_frame* current_coro_frame;
-            ucontext_t* scheduler_coro;  
+            silk::coro_context* scheduler_coro;
+            silk::stack_pool* stacks;
         };
         
         silk::wcontext* makeuwcontext() {
             uwcontext* c = new uwcontext();
             silk::init_wcontext(c);
-            c->scheduler_coro = new ucontext_t();
+            c->scheduler_coro = new silk::coro_context();
+            c->stacks = silk::make_stack_pool();
             return (silk::wcontext*)c;
         }
         
@@ -39,24 +61,27 @@ namespace silk {
             
             c->current_coro_frame->is_suspended = true;
             
-            swapcontext(c->current_coro_frame->coro, c->scheduler_coro);
+            silk::swap_coro_context(&c->current_coro_frame->coro, c->scheduler_coro);
         }
         
         #define define_coro (void(*)())
         #define yield yield();
         
+        // nullptr when no stack could be mapped, the coroutine is not started then
         template<typename... Args> coro_frame* spawn( void(*func)(), int stack_size, int args_size, Args... args ) {
-            char* stack = new char[stack_size];
-            ucontext_t* coro = new ucontext_t();
-            getcontext(coro);
-            coro->uc_stack.ss_sp = stack;
-            coro->uc_stack.ss_size = stack_size;
-            makecontext(coro, func, args_size, args...);
-        
-            coro_frame* f = new coro_frame();
-            f->stack_size = stack_size;
+            silk::stack* stack = silk::allocate_stack(fetch_current_uwcontext()->stacks, stack_size);
+        
+            if (!stack) {
+                perror("silk: mmap of a coroutine stack");
+        
+                return nullptr;
+            }
+        
+            // the frame lives at the top of its own stack, below it the coroutine's arguments and frames
+            coro_frame* f = new (stack->base + stack->size - sizeof(coro_frame)) coro_frame();
             f->stack = stack;
-            f->coro = coro;
+        
+            silk::make_coro_context(&f->coro, func, stack->base, stack->size - sizeof(coro_frame), args_size, args...);
         
             silk::spawn( silk::current_worker_id, (silk::task*) f );
             
@@ -67,42 +92,39 @@ namespace silk {
             spawn(current_worker_id, (silk::task*) frame);
         }
         
+        int kq;
+        
         void schedule( silk::task* t ) {
             uwcontext* c = fetch_current_uwcontext();
         
             c->current_coro_frame = (coro_frame*) t;
             c->current_coro_frame->is_suspended = false;
-            c->current_coro_frame->coro->uc_link = c->scheduler_coro;
+            c->current_coro_frame->coro.link = c->scheduler_coro;
         
             std::atomic_thread_fence(std::memory_order_acquire);
         
-            swapcontext( c->scheduler_coro, c->current_coro_frame->coro );
+            silk::swap_coro_context( c->scheduler_coro, &c->current_coro_frame->coro );
         
             if ( c->current_coro_frame->is_suspended ) {
-                std::function<void()> ay = c->current_coro_frame->after_yield;
+                after_yield_action ay = c->current_coro_frame->after_yield;
                
-                c->current_coro_frame->after_yield = nullptr;
+                c->current_coro_frame->after_yield.operation = after_yield_operation::nothing;
                
-                if ( ay ) {
-                    ay();
+                if ( ay.operation == after_yield_operation::wait_readable ) {
+                    struct kevent evSet;
+                    EV_SET(&evSet, ay.socket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, ay.udata);
+                    assert(-1 != kevent(kq, &evSet, 1, NULL, 0, NULL));
                 }
                
                 return;
             }
             
-            delete c->current_coro_frame->coro;
-            delete c->current_coro_frame->stack;
-            delete c->current_coro_frame;
-        }
+            silk::stack* stack = c->current_coro_frame->stack;
         
-        int kq;
+            c->current_coro_frame->~coro_frame();
         
-        typedef struct io_read_frame_t {
-            coro_frame* coro_frame;
-            int nbytes;
-            char* buf;
-            int n;
-        } io_read_frame;
+            silk::free_stack(c->stacks, stack);
+        }
         
         int read_async(const int socket, char* buf, const int nbytes ) {
             uwcontext* c = fetch_current_uwcontext();
@@ -121,24 +143,16 @@ namespace silk {
         
             c->current_coro_frame->read_sequence_count = 0;
         
-            io_read_frame* frame = new io_read_frame();
+            io_read_frame* frame = &c->current_coro_frame->read_frame;
             frame->coro_frame = c->current_coro_frame;
             frame->nbytes = nbytes;
             frame->buf = buf;
         
-            c->current_coro_frame->after_yield = [=]() {
-                struct kevent evSet;
-                EV_SET(&evSet, socket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, frame);
-                assert(-1 != kevent(kq, &evSet, 1, NULL, 0, NULL));
-            };
+            c->current_coro_frame->after_yield = { after_yield_operation::wait_readable, socket, frame };
         
             yield
         
-            int n = frame->n;
-        
-            delete frame;
-        
-            return n;
+            return frame->n;
         }
         
         int accept_async(const int listensocket, struct sockaddr* addr, socklen_t* socklen) {
@@ -150,11 +164,7 @@ namespace silk {
                 if (s == -1 && errno == EAGAIN) {
                     uwcontext* c = fetch_current_uwcontext();
                
-                    c->current_coro_frame->after_yield = [=]() {
-                        struct kevent evSet;
-                        EV_SET(&evSet, listensocket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, c->current_coro_frame);
-                        assert(-1 != kevent(kq, &evSet, 1, NULL, 0, NULL));
-                    };
+                    c->current_coro_frame->after_yield = { after_yield_operation::wait_readable, listensocket, c->current_coro_frame };
                    
                     yield
                    
@@ -1,4 +1,4 @@
-#include <experimental/coroutine>
+#include "./coroutine_support.h"
 #include "./../src/silk_pool.h"
 #include <sys/types.h>
 #include <sys/event.h>
@@ -9,28 +9,35 @@ namespace silk {
         template<typename T> struct task;
         struct independed_task;
         
+        struct frame : public silk::task {
+        	silk::coro::coroutine_handle<> coro;
+        };
+        
         struct task_promise_base {
-        	std::experimental::coroutine_handle<> continuation;
+        	frame frame_;
+        
+        	silk::coro::coroutine_handle<> continuation;
         };
         
         struct final_awaitable {
         	bool await_ready() const noexcept { return false; }
         
-        	template<typename T> void await_suspend(std::experimental::coroutine_handle<T> coro) {
-        		coro.promise().continuation.resume();
+        	// symmetric transfer: the awaiting coroutine is resumed by a jump, a long await chain does not grow the stack
+        	template<typename T> silk::coro::coroutine_handle<> await_suspend(silk::coro::coroutine_handle<T> coro) noexcept {
+        		silk::coro::coroutine_handle<> continuation = coro.promise().continuation;
+        
+        		return continuation ? continuation : silk::coro::noop_coroutine();
         	}
         
         	void await_resume() noexcept {}
         };
         
-        struct frame : public silk::task {
-        	std::experimental::coroutine_handle<> coro;
-        
-        	frame(std::experimental::coroutine_handle<> c) : coro(c) {}
-        };
+        inline void spawn(frame* f) {
+        	silk::spawn(silk::current_worker_id, (silk::task*) f);
+        }
         
-        void spawn(std::experimental::coroutine_handle<> coro) {
-        	silk::spawn(silk::current_worker_id, (silk::task*) new frame(coro));
+        template<typename P> void spawn(silk::coro::coroutine_handle<P> coro) {
+        	spawn(&coro.promise().frame_);
         }
         
         template<typename T = void> struct task_awaitable {
@@ -38,9 +45,10 @@ namespace silk {
         
         	bool await_ready() noexcept { return awaitable.coro.done(); }
         
-        	void await_suspend(std::experimental::coroutine_handle<> coro) noexcept {
+        	silk::coro::coroutine_handle<> await_suspend(silk::coro::coroutine_handle<> coro) noexcept {
         		awaitable.coro.promise().continuation = coro;
-        		awaitable.coro.resume();
+        
+        		return awaitable.coro;
         	}
         
         	auto await_resume() noexcept { return awaitable.result(); }
@@ -52,9 +60,9 @@ namespace silk {
         
         	task<T> get_return_object() noexcept;
         
-        	auto initial_suspend() { return std::experimental::suspend_always(); }
+        	auto initial_suspend() { return silk::coro::suspend_always(); }
         
-        	auto final_suspend() { return final_awaitable{}; }
+        	auto final_suspend() noexcept { return final_awaitable{}; }
         
         	void unhandled_exception() { e_ = std::current_exception(); }
         
@@ -72,9 +80,9 @@ namespace silk {
         template<> struct task_promise<void> : public task_promise_base {
         	task_promise() noexcept = default;
         	task<void> get_return_object() noexcept;
-        	auto initial_suspend() { return std::experimental::suspend_always{}; }
+        	auto initial_suspend() { return silk::coro::suspend_always{}; }
         
-        	auto final_suspend() { return final_awaitable{}; }
+        	auto final_suspend() noexcept { return final_awaitable{}; }
         
         	void return_void() noexcept {}
         
@@ -90,9 +98,9 @@ namespace silk {
         template<typename T = void> struct task {
         	using promise_type = task_promise<T>;
         
-        	std::experimental::coroutine_handle<task_promise<T>> coro;
+        	silk::coro::coroutine_handle<task_promise<T>> coro;
         
-        	task(std::experimental::coroutine_handle<task_promise<T>> c) : coro(c) {
+        	task(silk::coro::coroutine_handle<task_promise<T>> c) : coro(c) {
         	}
         
         	~task() {
@@ -106,18 +114,24 @@ namespace silk {
         };
         
         template<typename T> task<T> task_promise<T>::get_return_object() noexcept {
-        	return task<T> { std::experimental::coroutine_handle<task_promise>::from_promise(*this) };
+        	auto c = silk::coro::coroutine_handle<task_promise>::from_promise(*this);
+        	frame_.coro = c;
+        	return task<T> { c };
         }
         
         inline task<void> task_promise<void>::get_return_object() noexcept {
-        	return task<void> { std::experimental::coroutine_handle<task_promise>::from_promise(*this) };
+        	auto c = silk::coro::coroutine_handle<task_promise>::from_promise(*this);
+        	frame_.coro = c;
+        	return task<void> { c };
         }
         
         struct independed_task_promise {
+        	frame frame_;
+        
         	independed_task get_return_object() noexcept;
-        	auto initial_suspend() { return std::experimental::suspend_always{}; }
+        	auto initial_suspend() { return silk::coro::suspend_always{}; }
         
-        	auto final_suspend() { return std::experimental::suspend_never{}; }
+        	auto final_suspend() noexcept { return silk::coro::suspend_never{}; }
         
         	void return_void() noexcept {}
         
@@ -133,13 +147,15 @@ namespace silk {
         struct independed_task {
         	using promise_type = independed_task_promise;
         
-        	std::experimental::coroutine_handle<> coro;
+        	silk::coro::coroutine_handle<independed_task_promise> coro;
         
-        	independed_task(std::experimental::coroutine_handle<> c) : coro(c) { }
+        	independed_task(silk::coro::coroutine_handle<independed_task_promise> c) : coro(c) { }
         };
         
         inline independed_task independed_task_promise::get_return_object() noexcept {
-        	return independed_task{ std::experimental::coroutine_handle<independed_task_promise>::from_promise(*this) };
+        	auto c = silk::coro::coroutine_handle<independed_task_promise>::from_promise(*this);
+        	frame_.coro = c;
+        	return independed_task{ c };
         }
         
         void spawn(independed_task c) {
@@ -150,14 +166,12 @@ namespace silk {
         	frame* c = (frame*)t;
         
         	c->coro.resume();
-        
-        	delete c;
         }
         
         struct yield_awaitable {
         	bool await_ready() const noexcept { return false; }
         
-        	template<typename T> void await_suspend(std::experimental::coroutine_handle<T> c) {
+        	template<typename T> void await_suspend(silk::coro::coroutine_handle<T> c) {
         		spawn(c);
         	}
         
@@ -1,5 +1,8 @@
-#include <experimental/coroutine>
+#include "./coroutine_support.h"
+#include <iterator>
+#include <tuple>
 #include "./../src/silk_pool.h"
+#include "./coroutine_sync.h"
 #include <sys/types.h>
 #include <sys/event.h>
 #include <unistd.h>
@@ -13,33 +16,108 @@ namespace silk {
         template<typename T> struct task;
         struct independed_task;
         
-        enum task_state { unspawned, awaitable, completed };
+        enum task_state { unspawned, awaitable, completed, detached };
+        
+        struct frame : public silk::task {
+        	silk::coro::coroutine_handle<> coro;
+        };
+        
+        struct join_point;
         
         struct task_promise_base {
+        	frame frame_;
+        
         	std::atomic<task_state> state = task_state::unspawned;
         
-        	std::experimental::coroutine_handle<> continuation;
+        	frame* continuation = nullptr;
+        
+        	join_point* join = nullptr;
+        	int join_index = 0;
         };
         
-        struct frame : public silk::task {
-        	std::experimental::coroutine_handle<> coro;
+        inline void spawn(frame* f) {
+        	silk::spawn(silk::current_worker_id, (silk::task*) f);
+        }
+        
+        //---------------------------------------------------------
+        // Shared by the children of when_all/when_any instead of a
+        // continuation. count includes one extra arrival made by the awaiting
+        // coroutine after it has joined every child, so it is never resumed
+        // while still joining them. when_any joins live on the heap: losers
+        // arrive after the awaiting coroutine has moved on.
+        //---------------------------------------------------------
+        struct join_point {
+        	std::atomic<int> count;
+        	std::atomic<int> refs;
+        	std::atomic<int> first = -1;
+        	std::atomic<bool> is_cancelled = false;
+        	frame* continuation = nullptr;
+        	bool is_any;
+        
+        	join_point(const int children, const bool any) : count(any ? 2 : children + 1), refs(children + 1), is_any(any) {
+        	}
+        
+        	// returns true when the caller has to resume the awaiting coroutine
+        	bool arrive() {
+        		return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        	}
         
-        	frame(std::experimental::coroutine_handle<> c) : coro(c) {}
+        	// arrival of a completed child, returns the awaiting coroutine when the child has to resume it
+        	frame* arrive(const int index) {
+        		if (!is_any)
+        			return arrive() ? continuation : nullptr;
+        
+        		frame* resumed = nullptr;
+        
+        		int none = -1;
+        
+        		if (first.compare_exchange_strong(none, index, std::memory_order_acq_rel)) {
+        			is_cancelled.store(true, std::memory_order_release);
+        
+        			if (arrive()) {
+        				resumed = continuation;
+        			}
+        		}
+        
+        		release();
+        
+        		return resumed;
+        	}
+        
+        	void release() {
+        		if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        			delete this;
+        		}
+        	}
         };
         
-        void spawn(std::experimental::coroutine_handle<> coro) {
-        	silk::spawn(silk::current_worker_id, (silk::task*) new frame(coro));
+        template<typename P> void spawn(silk::coro::coroutine_handle<P> coro) {
+        	spawn(&coro.promise().frame_);
         }
         
         struct final_awaitable {
         	bool await_ready() const noexcept { return false; }
         
-        	template<typename T> void await_suspend(std::experimental::coroutine_handle<T> coro) {
+        	// symmetric transfer: the awaiting coroutine continues on this worker by a jump, not through the deque
+        	template<typename T> silk::coro::coroutine_handle<> await_suspend(silk::coro::coroutine_handle<T> coro) noexcept {
         		task_promise_base& p = coro.promise();
         
-        		if (p.state.exchange(task_state::completed, std::memory_order_release) == task_state::awaitable) {
-        			spawn(p.continuation);
+        		task_state s = p.state.exchange(task_state::completed, std::memory_order_acq_rel);
+        
+        		frame* resumed = nullptr;
+        
+        		// join, join_index and continuation are published by the release of the state change that
+        		// made the task awaitable (or detached), so they are read only after the exchange
+        		if (s == task_state::awaitable) {
+        			resumed = p.join ? p.join->arrive(p.join_index) : p.continuation;
+        		} else if (s == task_state::detached) {
+        			// a when_any loser, nobody holds its task anymore
+        			p.join->arrive(p.join_index);
+        
+        			coro.destroy();
         		}
+        
+        		return resumed ? resumed->coro : silk::coro::noop_coroutine();
         	}
         
         	void await_resume() noexcept {}
@@ -50,15 +128,17 @@ namespace silk {
         
         	bool await_ready() noexcept { return false; }
         
-        	void await_suspend(std::experimental::coroutine_handle<> coro) noexcept {
+        	// a child completed in the meantime resumes the awaiting coroutine at once, without the deque
+        	template<typename P> silk::coro::coroutine_handle<> await_suspend(silk::coro::coroutine_handle<P> coro) noexcept {
         		task_promise_base& p = awaitable.coro.promise();
         
-        		p.continuation = coro;
+        		p.continuation = &coro.promise().frame_;
         
         		task_state s = task_state::unspawned;
-        		if (!p.state.compare_exchange_strong(s, task_state::awaitable, std::memory_order_release)) {
-        			spawn(coro);
-        		}
+        		if (!p.state.compare_exchange_strong(s, task_state::awaitable, std::memory_order_acq_rel))
+        			return coro;
+        
+        		return silk::coro::noop_coroutine();
         	}
         
         	auto await_resume() noexcept { return awaitable.result(); }
@@ -70,9 +150,9 @@ namespace silk {
         
         	task<T> get_return_object() noexcept;
         
-        	auto initial_suspend() { return std::experimental::suspend_never{}; }
+        	auto initial_suspend() { return silk::coro::suspend_never{}; }
         
-        	auto final_suspend() { return final_awaitable{}; }
+        	auto final_suspend() noexcept { return final_awaitable{}; }
         
         	void unhandled_exception() { e_ = std::current_exception(); }
         
@@ -90,9 +170,9 @@ namespace silk {
         template<> struct task_promise<void> : public task_promise_base {
         	task_promise() noexcept = default;
         	task<void> get_return_object() noexcept;
-        	auto initial_suspend() { return std::experimental::suspend_never{}; }
+        	auto initial_suspend() { return silk::coro::suspend_never{}; }
         
-        	auto final_suspend() { return final_awaitable{}; }
+        	auto final_suspend() noexcept { return final_awaitable{}; }
         
         	void return_void() noexcept {}
         
@@ -108,9 +188,12 @@ namespace silk {
         template<typename T = void> struct task {
         	using promise_type = task_promise<T>;
         
-        	std::experimental::coroutine_handle<task_promise<T>> coro;
+        	silk::coro::coroutine_handle<task_promise<T>> coro;
         
-        	task(std::experimental::coroutine_handle<task_promise<T>> c) : coro(c) { }
+        	task(silk::coro::coroutine_handle<task_promise<T>> c) : coro(c) { }
+        
+        	// move only: the destructor frees a completed coroutine, a copy would free it twice
+        	task(task&& t) noexcept : coro(t.coro) { t.coro = nullptr; }
         
         	~task() {
         		if (coro && coro.done()) {
@@ -124,18 +207,35 @@ namespace silk {
         };
         
         template<typename T> task<T> task_promise<T>::get_return_object() noexcept {
-        	return task<T> { std::experimental::coroutine_handle<task_promise>::from_promise(*this) };
+        	auto c = silk::coro::coroutine_handle<task_promise>::from_promise(*this);
+        	frame_.coro = c;
+        	return task<T> { c };
         }
         
         inline task<void> task_promise<void>::get_return_object() noexcept {
-        	return task<void> { std::experimental::coroutine_handle<task_promise>::from_promise(*this) };
+        	auto c = silk::coro::coroutine_handle<task_promise>::from_promise(*this);
+        	frame_.coro = c;
+        	return task<void> { c };
         }
         
+        class async_scope;
+        
+        // scope of the independed_task being created by async_scope on this thread
+        thread_local async_scope* spawning_scope = nullptr;
+        
         struct independed_task_promise {
+        	frame frame_;
+        
+        	async_scope* scope;
+        
+        	independed_task_promise();
+        
+        	~independed_task_promise();
+        
         	independed_task get_return_object() noexcept;
-        	auto initial_suspend() { return std::experimental::suspend_never{}; }
+        	auto initial_suspend() { return silk::coro::suspend_never{}; }
         
-        	auto final_suspend() { return std::experimental::suspend_never{}; }
+        	auto final_suspend() noexcept { return silk::coro::suspend_never{}; }
         
         	void return_void() noexcept {}
         
@@ -151,27 +251,32 @@ namespace silk {
         struct independed_task {
         	using promise_type = independed_task_promise;
         
-        	std::experimental::coroutine_handle<> coro;
+        	silk::coro::coroutine_handle<independed_task_promise> coro;
         
-        	independed_task(std::experimental::coroutine_handle<> c) : coro(c) { }
+        	independed_task(silk::coro::coroutine_handle<independed_task_promise> c) : coro(c) { }
         };
         
         inline independed_task independed_task_promise::get_return_object() noexcept {
-        	return independed_task{ std::experimental::coroutine_handle<independed_task_promise>::from_promise(*this) };
+        	auto c = silk::coro::coroutine_handle<independed_task_promise>::from_promise(*this);
+        	frame_.coro = c;
+        	return independed_task{ c };
         }
         
         void schedule(silk::task* t) {
         	frame* c = (frame*)t;
         	
-        	c->coro.resume();
+        	// an event loop thread resumes coroutines too, outside the pool loops the budget is not counted
+        	if (silk::is_in_pool_loop) {
+        		silk::refill_budget(silk::current_worker_id);
+        	}
         
-        	delete c;
+        	c->coro.resume();
         }
         
         struct yield_awaitable {
         	bool await_ready() const noexcept { return false; }
         
-        	template<typename T> void await_suspend(std::experimental::coroutine_handle<T> c) {
+        	template<typename T> void await_suspend(silk::coro::coroutine_handle<T> c) {
         		spawn(c);
         	}
         
@@ -182,6 +287,341 @@ namespace silk {
         	return yield_awaitable{};
         }
         
+        template<typename... Ts> struct task_pack {
+        	std::tuple<task<Ts>&...> tasks;
+        
+        	int size() const { return sizeof...(Ts); }
+        
+        	template<typename F> void for_each(F f) {
+        		std::apply([&f](auto&... t) { (f(t), ...); }, tasks);
+        	}
+        };
+        
+        template<typename Range> struct task_range {
+        	Range& tasks;
+        
+        	int size() const { return (int) std::distance(std::begin(tasks), std::end(tasks)); }
+        
+        	template<typename F> void for_each(F f) {
+        		for (auto& t : tasks) {
+        			f(t);
+        		}
+        	}
+        };
+        
+        // Children are already running (tasks start immediately), they are only joined under j.
+        template<typename Tasks> void join_children(Tasks& tasks, join_point* j) {
+        	int index = 0;
+        
+        	tasks.for_each([j, &index](auto& t) {
+        		task_promise_base& p = t.coro.promise();
+        
+        		p.join = j;
+        		p.join_index = index;
+        
+        		task_state s = task_state::unspawned;
+        
+        		if (!p.state.compare_exchange_strong(s, task_state::awaitable, std::memory_order_acq_rel)) {
+        			j->arrive(index);
+        		}
+        
+        		index++;
+        	});
+        }
+        
+        template<typename Tasks> struct when_all_awaitable {
+        	Tasks tasks;
+        	join_point join;
+        
+        	when_all_awaitable(Tasks t) : tasks(t), join(t.size(), false) {
+        	}
+        
+        	bool await_ready() noexcept { return tasks.size() == 0; }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		join.continuation = &coro.promise().frame_;
+        
+        		join_children(tasks, &join);
+        
+        		return !join.arrive();
+        	}
+        
+        	// rethrows the first exception in argument order, results are read with task::result()
+        	void await_resume() {
+        		tasks.for_each([](auto& t) {
+        			t.coro.promise().join = nullptr;
+        		});
+        
+        		tasks.for_each([](auto& t) {
+        			t.coro.promise().result();
+        		});
+        	}
+        };
+        
+        template<typename Tasks> struct when_any_awaitable {
+        	Tasks tasks;
+        	join_point* join;
+        
+        	when_any_awaitable(Tasks t) : tasks(t), join(nullptr) {
+        	}
+        
+        	bool await_ready() noexcept { return tasks.size() == 0; }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		join = new join_point(tasks.size(), true);
+        		join->continuation = &coro.promise().frame_;
+        
+        		join_children(tasks, join);
+        
+        		return !join->arrive();
+        	}
+        
+        	// returns the index of the first completed child, -1 when there are none
+        	int await_resume() {
+        		if (!join)
+        			return -1;
+        
+        		const int winner = join->first.load(std::memory_order_acquire);
+        
+        		int index = 0;
+        
+        		tasks.for_each([winner, &index](auto& t) {
+        			task_promise_base& p = t.coro.promise();
+        
+        			if (index != winner && p.state.exchange(task_state::detached, std::memory_order_acq_rel) != task_state::completed) {
+        				// still running, it destroys itself when done
+        				t.coro = nullptr;
+        			}
+        
+        			index++;
+        		});
+        
+        		join->release();
+        
+        		return winner;
+        	}
+        };
+        
+        // co_await when_all(t1, t2, ...) resumes once, after the last of the tasks completes.
+        template<typename... Ts> auto when_all(task<Ts>&... tasks) {
+        	return when_all_awaitable<task_pack<Ts...>>(task_pack<Ts...>{ std::tuple<task<Ts>&...>(tasks...) });
+        }
+        
+        template<typename Range> auto when_all(Range& tasks) {
+        	return when_all_awaitable<task_range<Range>>(task_range<Range>{ tasks });
+        }
+        
+        // co_await when_any(t1, t2, ...) resumes after the first task completes and returns its index;
+        // the others see is_cancelled() and are released (and freed) when they finish.
+        template<typename... Ts> auto when_any(task<Ts>&... tasks) {
+        	return when_any_awaitable<task_pack<Ts...>>(task_pack<Ts...>{ std::tuple<task<Ts>&...>(tasks...) });
+        }
+        
+        template<typename Range> auto when_any(Range& tasks) {
+        	return when_any_awaitable<task_range<Range>>(task_range<Range>{ tasks });
+        }
+        
+        struct cancellation_awaitable {
+        	join_point* join;
+        
+        	bool await_ready() const noexcept { return false; }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) noexcept {
+        		join = coro.promise().join;
+        
+        		return false;
+        	}
+        
+        	bool await_resume() noexcept { return join && join->is_cancelled.load(std::memory_order_acquire); }
+        };
+        
+        // co_await is_cancelled() is true inside a when_any child once another child has won.
+        inline cancellation_awaitable is_cancelled() {
+        	return cancellation_awaitable{ nullptr };
+        }
+        
+        //---------------------------------------------------------
+        // Owns dynamically spawned independed_task coroutines: at most
+        // max_concurrency of them run at once (0 - no limit), co_await spawn()
+        // suspends the spawner while the scope is full, and co_await join()
+        // resumes after every coroutine of the scope has completed. Waiting
+        // coroutines are linked through their frames, the scope allocates
+        // nothing; a coroutine frame is freed as soon as it completes.
+        //---------------------------------------------------------
+        class async_scope {
+        	silk::spin_lock sync_;
+        	int active_ = 0;
+        	int max_concurrency_;
+        	frame* spawners_head_ = nullptr;
+        	frame* spawners_tail_ = nullptr;
+        	frame* joiners_ = nullptr;
+        
+        	// takes a slot or queues the spawner, returns true when a slot was taken
+        	bool acquire(frame* spawner) {
+        		sync_.lock();
+        
+        		const bool is_acquired = max_concurrency_ == 0 || active_ < max_concurrency_;
+        
+        		if (is_acquired) {
+        			active_++;
+        		} else {
+        			spawner->next = nullptr;
+        
+        			if (spawners_tail_) {
+        				spawners_tail_->next = spawner;
+        			} else {
+        				spawners_head_ = spawner;
+        			}
+        
+        			spawners_tail_ = spawner;
+        		}
+        
+        		sync_.unlock();
+        
+        		return is_acquired;
+        	}
+        
+        	// the coroutine starts running inside f(), its promise picks the scope up from spawning_scope
+        	template<typename F> void start(F& f) {
+        		spawning_scope = this;
+        		f();
+        		spawning_scope = nullptr;
+        	}
+        
+        	template<typename F> friend struct scope_spawn_awaitable;
+        	friend struct scope_join_awaitable;
+        public:
+        	async_scope(const int max_concurrency = 0) : max_concurrency_(max_concurrency) {
+        	}
+        
+        	async_scope(const async_scope&) = delete;
+        
+        	~async_scope() {
+        		assert(active_ == 0 && "async_scope destroyed before join");
+        	}
+        
+        	// co_await spawn(f) starts the independed_task returned by f() in the scope, waiting for a free slot first
+        	template<typename F> auto spawn(F f);
+        
+        	// starts f() right away if a slot is free, for callers that are not coroutines
+        	template<typename F> bool try_spawn(F f) {
+        		sync_.lock();
+        
+        		const bool is_acquired = max_concurrency_ == 0 || active_ < max_concurrency_;
+        
+        		if (is_acquired) {
+        			active_++;
+        		}
+        
+        		sync_.unlock();
+        
+        		if (is_acquired) {
+        			start(f);
+        		}
+        
+        		return is_acquired;
+        	}
+        
+        	auto join();
+        
+        	int active() {
+        		sync_.lock();
+        		const int a = active_;
+        		sync_.unlock();
+        		return a;
+        	}
+        
+        	// called when a coroutine of the scope completes: its slot goes to the first waiting spawner
+        	void complete() {
+        		sync_.lock();
+        
+        		frame* spawner = spawners_head_;
+        		frame* joiners = nullptr;
+        
+        		if (spawner) {
+        			spawners_head_ = (frame*) spawner->next;
+        
+        			if (!spawners_head_) {
+        				spawners_tail_ = nullptr;
+        			}
+        		} else if (--active_ == 0) {
+        			joiners = joiners_;
+        			joiners_ = nullptr;
+        		}
+        
+        		sync_.unlock();
+        
+        		if (spawner) {
+        			silk::demo_runtime_4_3::spawn(spawner);
+        		}
+        
+        		while (joiners) {
+        			frame* j = joiners;
+        			joiners = (frame*) j->next;
+        			silk::demo_runtime_4_3::spawn(j);
+        		}
+        	}
+        };
+        
+        template<typename F> struct scope_spawn_awaitable {
+        	async_scope& scope;
+        	F f;
+        
+        	bool await_ready() noexcept { return false; }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		return !scope.acquire(&coro.promise().frame_);
+        	}
+        
+        	// the slot is held here, either taken right away or handed over by complete()
+        	void await_resume() {
+        		scope.start(f);
+        	}
+        };
+        
+        struct scope_join_awaitable {
+        	async_scope& scope;
+        
+        	bool await_ready() noexcept { return false; }
+        
+        	template<typename P> bool await_suspend(silk::coro::coroutine_handle<P> coro) {
+        		frame* f = &coro.promise().frame_;
+        
+        		scope.sync_.lock();
+        
+        		const bool is_pending = scope.active_ > 0;
+        
+        		if (is_pending) {
+        			f->next = scope.joiners_;
+        			scope.joiners_ = f;
+        		}
+        
+        		scope.sync_.unlock();
+        
+        		return is_pending;
+        	}
+        
+        	void await_resume() noexcept {}
+        };
+        
+        template<typename F> auto async_scope::spawn(F f) {
+        	return scope_spawn_awaitable<F>{ *this, f };
+        }
+        
+        inline auto async_scope::join() {
+        	return scope_join_awaitable{ *this };
+        }
+        
+        inline independed_task_promise::independed_task_promise() : scope(spawning_scope) {
+        	spawning_scope = nullptr;
+        }
+        
+        inline independed_task_promise::~independed_task_promise() {
+        	if (scope) {
+        		scope->complete();
+        	}
+        }
+        
         int kq;
         
         struct io_read_awaitable {
@@ -190,12 +630,32 @@ namespace silk {
             int socket;
         
 	        int n;
-	        std::experimental::coroutine_handle<> coro;
+	        frame* coro;
+	        bool is_yielding = false;
         
-            constexpr bool await_ready() const noexcept { return false; }
+	        // reads at once when data is there, within the budget of the task
+	        bool await_ready() noexcept {
+	        	memset(buf, 0, nbytes);
+        
+	        	n = read(socket, buf, nbytes); //NON-BLOCKING MODE...
+        
+	        	if (n == -1 && errno == EAGAIN)
+	        		return is_yielding = false;
+        
+	        	is_yielding = silk::demo_coroutines::is_budget_spent();
+        
+	        	return !is_yielding;
+	        }
+                
+            template<typename P> void await_suspend(silk::coro::coroutine_handle<P> c) {
+                coro = &c.promise().frame_;
+        
+	        	if (is_yielding) {
+	        		silk::demo_coroutines::requeue(silk::demo_coroutines::frame_of(c));
+        
+	        		return;
+	        	}
                 
-            void await_suspend(std::experimental::coroutine_handle<> c) {
-                coro = c;
                 struct kevent evSet;
                 EV_SET(&evSet, socket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, this);
                 assert(-1 != kevent(kq, & evSet, 1, NULL, 0, NULL));
@@ -209,6 +669,7 @@ namespace silk {
 	        struct sockaddr_storage addr;
 	        socklen_t socklen = sizeof(addr);
 	        bool success;
+	        bool is_yielding = false;
 	        int err;
 	        int s;
            
@@ -216,12 +677,19 @@ namespace silk {
 	        	s = accept(listening_socket, (struct sockaddr *)&addr, &socklen);
                 success = !(s == -1 && errno == EAGAIN);
                 err = errno;
-                return success;
+                is_yielding = success && silk::demo_coroutines::is_budget_spent();
+                return success && !is_yielding;
             }
                
-            void await_suspend(std::experimental::coroutine_handle<> coro) {
+            template<typename P> void await_suspend(silk::coro::coroutine_handle<P> coro) {
+	        	if (is_yielding) {
+	        		silk::demo_coroutines::requeue(silk::demo_coroutines::frame_of(coro));
+        
+	        		return;
+	        	}
+        
 	        	struct kevent evSet;
-                EV_SET(&evSet, listening_socket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, new frame(coro));
+                EV_SET(&evSet, listening_socket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, &coro.promise().frame_);
                 assert(-1 != kevent(kq, & evSet, 1, NULL, 0, NULL));
             }
            
@@ -259,9 +727,9 @@ namespace silk {
         		return result == 0 || (result = -1 && err != EINPROGRESS);
             }
                
-            void await_suspend(std::experimental::coroutine_handle<> coro) {
+            template<typename P> void await_suspend(silk::coro::coroutine_handle<P> coro) {
         		struct kevent evSet;
-                EV_SET(&evSet, s, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, new frame(coro));
+                EV_SET(&evSet, s, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, &coro.promise().frame_);
                 assert(-1 != kevent(kq, & evSet, 1, NULL, 0, NULL));
             }
            
@@ -277,9 +745,9 @@ namespace silk {
         
             bool await_ready() noexcept { return false; }
                
-            void await_suspend(std::experimental::coroutine_handle<> coro) {
+            template<typename P> void await_suspend(silk::coro::coroutine_handle<P> coro) {
         		struct kevent evSet;
-                EV_SET(&evSet, s, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, new frame(coro));
+                EV_SET(&evSet, s, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, &coro.promise().frame_);
                 assert(-1 != kevent(kq, & evSet, 1, NULL, 0, NULL));
             }
            
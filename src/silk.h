@@ -2,12 +2,15 @@
 
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <stdint.h>
 
 #if defined(_WIN32)
 //---------------------------------------------------------
 // Semaphore (Windows)
 //---------------------------------------------------------
 #include <windows.h>
+#include <intrin.h>
 #undef min
 #undef max
 #elif defined(__MACH__)
@@ -192,8 +195,24 @@ namespace silk {
     struct task {
     	task* next;
     	task* prev;
+    	int64_t deadline;
+    #if defined(SILK_QUEUE_STATS)
+    	int64_t queued_at;
+    #endif
     };
     
+    //---------------------------------------------------------
+    // Queue residency stats, compiled in with SILK_QUEUE_STATS defined
+    // before silk.h is included: every task is stamped when it is queued,
+    // and per worker and kind of queue the longest time a task waited
+    // there is kept. Costs a clock read per queued and per taken task.
+    //---------------------------------------------------------
+    enum queue_kind { deque_queue, affinity_queue, mailbox_queue, deadline_queue, queue_kinds_count };
+    
+    inline int64_t now_ns() {
+    	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
     struct wcontext {
     	fast_random* random;
     	spin_lock* affinity_sync;
@@ -202,27 +221,224 @@ namespace silk {
     	spin_lock* sync;
     	task* tail;
     	task* head;
+    	std::atomic<int> tasks_count;
+    	std::atomic<bool> is_thief_waiting;
+    	std::atomic<task*> next_task;
+    	int next_task_streak;
+    	spin_lock* mailbox_sync;
+    	task* mailbox_tail;
+    	task* mailbox_head;
+    	std::atomic<int> mailbox_count;
+    	int inline_depth;
+    	int fair_poll_count;
+    	int64_t last_fair_poll_time;
+    	spin_lock* deadline_sync;
+    	task* deadline_heap;
+    	std::atomic<int64_t> earliest_deadline;
+    	std::atomic<long> deadline_tasks_count;
+    	std::atomic<long> deadline_misses_count;
+    	int budget;
+    	std::atomic<long> budget_spent_count;
+    	std::atomic<long> budget_yields_count;
+    #if defined(SILK_QUEUE_STATS)
+    	std::atomic<int64_t> max_residency[queue_kinds_count];
+    #endif
     };
     
+    // How many run-next tasks in a row a worker takes before its deque goes first once.
+    const int next_task_streak_limit = 3;
+    
     int workers_count;
     wcontext** wcontexts;
     auto_reset_event* sem = new auto_reset_event();
     
+    inline void stamp(task* t) {
+    #if defined(SILK_QUEUE_STATS)
+    	t->queued_at = now_ns();
+    #else
+    	(void) t;
+    #endif
+    }
+    
+    // t has just been taken from a queue of kind q of worker_id
+    inline void record_residency(const int worker_id, const queue_kind q, task* t) {
+    #if defined(SILK_QUEUE_STATS)
+    	const int64_t residency = now_ns() - t->queued_at;
+    
+    	std::atomic<int64_t>& max = wcontexts[worker_id]->max_residency[q];
+    
+    	int64_t old = max.load(std::memory_order_relaxed);
+    
+    	while (residency > old && !max.compare_exchange_weak(old, residency, std::memory_order_relaxed)) {
+    	}
+    #else
+    	(void) worker_id; (void) q; (void) t;
+    #endif
+    }
+    
+    // Longest time in ns a task waited in a queue of kind q, over all workers since the last reset_queue_stats().
+    // Always 0 without SILK_QUEUE_STATS.
+    inline int64_t max_queue_residency(const queue_kind q) {
+    	int64_t max = 0;
+    #if defined(SILK_QUEUE_STATS)
+    	for (int w = 0; w < workers_count; w++) {
+    		const int64_t r = wcontexts[w]->max_residency[q].load(std::memory_order_relaxed);
+    
+    		max = r > max ? r : max;
+    	}
+    #else
+    	(void) q;
+    #endif
+    	return max;
+    }
+    
+    inline void reset_queue_stats() {
+    #if defined(SILK_QUEUE_STATS)
+    	for (int w = 0; w < workers_count; w++) {
+    		for (int q = 0; q < queue_kinds_count; q++) {
+    			wcontexts[w]->max_residency[q].store(0, std::memory_order_relaxed);
+    		}
+    	}
+    #endif
+    }
+    
+    //---------------------------------------------------------
+    // Occupancy bitmaps: bit w is set while the deque (mailbox, deadline
+    // heap) of worker w is not empty. A bit flips under the lock of its queue on
+    // the empty/non-empty transitions only, so thieves probe non-empty
+    // victims instead of taking the locks of empty ones, and see at once
+    // when there is nothing to steal at all. The run-next slot has no lock:
+    // its bit is set after the slot is filled and cleared after it is
+    // emptied, then set again if it was refilled meanwhile, so a bit may be
+    // set for an empty slot for a while, but never clear for a full one.
+    //---------------------------------------------------------
+    int occupancy_words_count;
+    std::atomic<uint64_t>* occupied_deques;
+    std::atomic<uint64_t>* occupied_mailboxes;
+    std::atomic<uint64_t>* occupied_deadlines;
+    std::atomic<uint64_t>* occupied_next;
+    
+    inline void set_occupied(std::atomic<uint64_t>* map, const int worker_id) {
+    	map[worker_id >> 6].fetch_or(uint64_t(1) << (worker_id & 63), std::memory_order_release);
+    }
+    
+    inline void clear_occupied(std::atomic<uint64_t>* map, const int worker_id) {
+    	map[worker_id >> 6].fetch_and(~(uint64_t(1) << (worker_id & 63)), std::memory_order_acq_rel);
+    }
+    
+    inline uint64_t occupied_word(const int word) {
+    	return occupied_deques[word].load(std::memory_order_acquire) | occupied_mailboxes[word].load(std::memory_order_acquire) |
+    		occupied_deadlines[word].load(std::memory_order_acquire);
+    }
+    
+    inline uint64_t occupied_next_word(const int word) {
+    	return occupied_next[word].load(std::memory_order_acquire);
+    }
+    
+    inline bool is_any_occupied() {
+    	for (int w = 0; w < occupancy_words_count; w++) {
+    		if (occupied_word(w) | occupied_next_word(w))
+    			return true;
+    	}
+    
+    	return false;
+    }
+    
+    inline int lowest_bit(const uint64_t bits) {
+    #if defined(_MSC_VER)
+    	unsigned long i;
+    	_BitScanForward64(&i, bits);
+    	return int(i);
+    #else
+    	return __builtin_ctzll(bits);
+    #endif
+    }
+    
+    // First worker other than the thief at or after start, cyclically, with its bit set in word(w); -1 when there is none.
+    template<typename Word> inline int find_occupied(const int thief_thread_id, const int start, Word word) {
+    	const int start_word = start >> 6;
+    	const uint64_t start_bit = uint64_t(1) << (start & 63);
+    
+    	for (int i = 0; i <= occupancy_words_count; i++) {
+    		const int w = (start_word + i) % occupancy_words_count;
+    
+    		uint64_t bits = word(w);
+    
+    		if (w == thief_thread_id >> 6) {
+    			bits &= ~(uint64_t(1) << (thief_thread_id & 63));
+    		}
+    
+    		if (i == 0) {
+    			bits &= ~(start_bit - 1);
+    		} else if (i == occupancy_words_count) {
+    			bits &= start_bit - 1;
+    		}
+    
+    		if (bits)
+    			return (w << 6) + lowest_bit(bits);
+    	}
+    
+    	return -1;
+    }
+    
+    // First worker with a queued task (deque, mailbox or deadline heap) to steal.
+    inline int find_victim(const int thief_thread_id, const int start) {
+    	return find_occupied(thief_thread_id, start, occupied_word);
+    }
+    
+    // First worker with a task in its run-next slot.
+    inline int find_next_victim(const int thief_thread_id, const int start) {
+    	return find_occupied(thief_thread_id, start, occupied_next_word);
+    }
+    
+    //---------------------------------------------------------
+    // Spawn throttling: a worker that already has max_queued_tasks tasks in
+    // its deque is throttled, and a runtime runs the task it spawns inline
+    // instead of queueing it, until the deque drains below the limit. This
+    // keeps queued tasks under about workers_count * max_queued_tasks for
+    // any fan-out. Inline runs nest on the stack of the worker
+    // (inline_depth), so past max_inline_depth the task is queued anyway.
+    // max_queued_tasks == 0 turns throttling off.
+    //---------------------------------------------------------
+    int max_queued_tasks = 0;
+    int max_inline_depth = 256;
+    
+    inline void set_spawn_limits(const int queued_tasks, const int inline_depth = 256) {
+    	max_queued_tasks = queued_tasks;
+    	max_inline_depth = inline_depth;
+    }
+    
+    // Hint for a runtime: true when the task worker_id spawns now should run inline.
+    inline bool is_spawn_throttled(const int worker_id) {
+    	if (max_queued_tasks <= 0)
+    		return false;
+    
+    	wcontext* c = wcontexts[worker_id];
+    
+    	return c->tasks_count.load(std::memory_order_relaxed) >= max_queued_tasks && c->inline_depth < max_inline_depth;
+    }
+    
     inline void spawn(const int worker_id, task* t) {
     	wcontext* c = wcontexts[worker_id];
     
     	t->prev = t->next = nullptr;
         
+    	stamp(t);
+    
     	c->sync->lock();
     
     	if (!c->head) {
     		c->tail = c->head = t;
+    
+    		set_occupied(occupied_deques, worker_id);
     	} else {
     		t->next = c->head;
     		c->head->prev = t;
     		c->head = t;
     	}
     
+    	c->tasks_count.fetch_add(1, std::memory_order_relaxed);
+    
     	c->sync->unlock();
     
     	sem->signal(workers_count);
@@ -240,12 +456,359 @@ namespace silk {
     		
     		c->head = t->next;
     
-    		if (!c->head)
+    		if (!c->head) {
     			c->tail = nullptr;
-    		else
+    
+    			clear_occupied(occupied_deques, worker_id);
+    		} else {
     			c->head->prev = nullptr;
+    		}
+    
+    		t->prev = t->next = nullptr;
+    
+    		c->tasks_count.fetch_sub(1, std::memory_order_relaxed);
+    
+    		record_residency(worker_id, deque_queue, t);
+    	}
+    
+    	c->sync->unlock();
+    
+    	return t;
+    }
+    
+    // Puts t into the run-next slot of the worker: it runs right after the current task, before the deque and
+    // without its lock. A task already in the slot is moved to the head of the deque. For a task woken by the
+    // running one (message passing, ping-pong), which then runs while the data it needs is still in cache.
+    inline void spawn_next(const int worker_id, task* t) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	task* displaced = c->next_task.exchange(t, std::memory_order_acq_rel);
+    
+    	if (displaced) {
+    		spawn(worker_id, displaced);
+    	} else {
+    		set_occupied(occupied_next, worker_id);
+    
+    		// a parked worker can take it when this one is busy for long
+    		sem->signal(workers_count);
+    	}
+    }
+    
+    // Soft affinity: t goes to the mailbox of worker_id, which takes its mail (oldest first) before its own deque.
+    // Unlike spawn_affinity, thieves take mail too once the deque of its worker is empty, so a busy worker
+    // does not hold it back.
+    inline void spawn_mailbox(const int worker_id, task* t) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	t->prev = t->next = nullptr;
+    
+    	stamp(t);
+    
+    	c->mailbox_sync->lock();
+    
+    	if (!c->mailbox_tail) {
+    		c->mailbox_head = c->mailbox_tail = t;
+    
+    		set_occupied(occupied_mailboxes, worker_id);
+    	} else {
+    		t->prev = c->mailbox_tail;
+    		c->mailbox_tail->next = t;
+    		c->mailbox_tail = t;
+    	}
+    
+    	c->mailbox_count.fetch_add(1, std::memory_order_relaxed);
+    
+    	c->mailbox_sync->unlock();
+    
+    	sem->signal(workers_count);
+    }
+    
+    // The owner takes the oldest mail, a thief the newest.
+    inline task* take_mail(const int worker_id, const bool is_owner) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	if (c->mailbox_count.load(std::memory_order_relaxed) == 0)
+    		return nullptr;
+    
+    	task* t = nullptr;
+    
+    	c->mailbox_sync->lock();
+    
+    	if (c->mailbox_head) {
+    		if (is_owner) {
+    			t = c->mailbox_head;
+    			c->mailbox_head = t->next;
+    
+    			if (!c->mailbox_head)
+    				c->mailbox_tail = nullptr;
+    			else
+    				c->mailbox_head->prev = nullptr;
+    		} else {
+    			t = c->mailbox_tail;
+    			c->mailbox_tail = t->prev;
+    
+    			if (!c->mailbox_tail)
+    				c->mailbox_head = nullptr;
+    			else
+    				c->mailbox_tail->next = nullptr;
+    		}
+    
+    		if (!c->mailbox_head) {
+    			clear_occupied(occupied_mailboxes, worker_id);
+    		}
+    
+    		t->prev = t->next = nullptr;
+    
+    		c->mailbox_count.fetch_sub(1, std::memory_order_relaxed);
+    
+    		record_residency(worker_id, mailbox_queue, t);
+    	}
+    
+    	c->mailbox_sync->unlock();
+    
+    	return t;
+    }
+    
+    // Clears the run-next bit of worker_id, unless its slot has been filled again meanwhile.
+    inline void clear_next_occupied(const int worker_id) {
+    	clear_occupied(occupied_next, worker_id);
+    
+    	if (wcontexts[worker_id]->next_task.load(std::memory_order_acquire)) {
+    		set_occupied(occupied_next, worker_id);
+    	}
+    }
+    
+    inline task* take_next_task(const int worker_id) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	if (!c->next_task.load(std::memory_order_relaxed))
+    		return nullptr;
+    
+    	task* t = c->next_task.exchange(nullptr, std::memory_order_acq_rel);
+    
+    	if (t) {
+    		clear_next_occupied(worker_id);
+    	}
+    
+    	return t;
+    }
+    
+    //---------------------------------------------------------
+    // Deadline scheduling (EDF). In deadline mode every worker keeps the
+    // tasks given to spawn_deadline in a heap ordered by deadline, next to
+    // its deque, and takes the earliest deadline before anything else but
+    // a fair poll. Thieves take the earliest deadline of all workers first.
+    // A deadline task that starts after its deadline counts as a miss.
+    // Outside deadline mode spawn_deadline is spawn (heaps filled before
+    // are still drained first). The heap is an intrusive pairing heap:
+    // next links siblings, prev the first child.
+    //---------------------------------------------------------
+    bool is_deadline_mode = false;
+    
+    inline void set_deadline_mode(const bool is_on) {
+    	is_deadline_mode = is_on;
+    }
+    
+    inline task* meld(task* a, task* b) {
+    	if (!a)
+    		return b;
+    
+    	if (!b)
+    		return a;
+    
+    	if (b->deadline < a->deadline) {
+    		task* r = a;
+    		a = b;
+    		b = r;
+    	}
+    
+    	b->next = a->prev;
+    	a->prev = b;
+    
+    	return a;
+    }
+    
+    // Melds the sibling list of a removed root back into one heap (two passes).
+    inline task* meld_siblings(task* first) {
+    	task* pairs = nullptr;
+    
+    	while (first) {
+    		task* a = first;
+    		task* b = a->next;
+    
+    		first = b ? b->next : nullptr;
+    
+    		a->next = nullptr;
+    
+    		if (b) {
+    			b->next = nullptr;
+    			a = meld(a, b);
+    		}
+    
+    		a->next = pairs;
+    		pairs = a;
+    	}
+    
+    	task* root = nullptr;
+    
+    	while (pairs) {
+    		task* a = pairs;
+    		pairs = a->next;
+    		a->next = nullptr;
+    		root = meld(a, root);
+    	}
+    
+    	return root;
+    }
+    
+    // deadline is in now_ns() time
+    inline void spawn_deadline(const int worker_id, task* t, const int64_t deadline) {
+    	if (!is_deadline_mode) {
+    		spawn(worker_id, t);
+    
+    		return;
+    	}
+    
+    	wcontext* c = wcontexts[worker_id];
+    
+    	t->prev = t->next = nullptr;
+    	t->deadline = deadline;
+    
+    	stamp(t);
+    
+    	c->deadline_sync->lock();
+    
+    	if (!c->deadline_heap) {
+    		set_occupied(occupied_deadlines, worker_id);
+    	}
+    
+    	c->deadline_heap = meld(c->deadline_heap, t);
+    	c->earliest_deadline.store(c->deadline_heap->deadline, std::memory_order_relaxed);
+    
+    	c->deadline_sync->unlock();
+    
+    	sem->signal(workers_count);
+    }
+    
+    // The task with the earliest deadline from the heap of worker_id.
+    inline task* take_most_urgent(const int worker_id) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	if (c->earliest_deadline.load(std::memory_order_relaxed) == INT64_MAX)
+    		return nullptr;
+    
+    	task* t = nullptr;
+    
+    	c->deadline_sync->lock();
+    
+    	if (c->deadline_heap) {
+    		t = c->deadline_heap;
+    		c->deadline_heap = meld_siblings(t->prev);
+    
+    		if (c->deadline_heap) {
+    			c->earliest_deadline.store(c->deadline_heap->deadline, std::memory_order_relaxed);
+    		} else {
+    			c->earliest_deadline.store(INT64_MAX, std::memory_order_relaxed);
+    
+    			clear_occupied(occupied_deadlines, worker_id);
+    		}
+    
+    		t->prev = t->next = nullptr;
+    
+    		record_residency(worker_id, deadline_queue, t);
+    	}
+    
+    	c->deadline_sync->unlock();
+    
+    	if (t) {
+    		c->deadline_tasks_count.fetch_add(1, std::memory_order_relaxed);
+    
+    		if (now_ns() > t->deadline) {
+    			c->deadline_misses_count.fetch_add(1, std::memory_order_relaxed);
+    		}
+    	}
+    
+    	return t;
+    }
+    
+    // The earliest deadline among the heaps of the other workers.
+    inline task* steal_most_urgent(const int thief_thread_id) {
+    	int victim = -1;
+    	int64_t earliest = INT64_MAX;
+    
+    	for (int w = 0; w < occupancy_words_count; w++) {
+    		uint64_t bits = occupied_deadlines[w].load(std::memory_order_acquire);
+    
+    		while (bits) {
+    			const int v = (w << 6) + lowest_bit(bits);
+    
+    			bits &= bits - 1;
+    
+    			const int64_t d = wcontexts[v]->earliest_deadline.load(std::memory_order_relaxed);
+    
+    			if (v != thief_thread_id && d < earliest) {
+    				earliest = d;
+    				victim = v;
+    			}
+    		}
+    	}
+    
+    	return victim < 0 ? nullptr : take_most_urgent(victim);
+    }
+    
+    // Deadline tasks started so far, and how many of them started after their deadline.
+    inline long deadline_tasks() {
+    	long n = 0;
+    
+    	for (int w = 0; w < workers_count; w++) {
+    		n += wcontexts[w]->deadline_tasks_count.load(std::memory_order_relaxed);
+    	}
+    
+    	return n;
+    }
+    
+    inline long deadline_misses() {
+    	long n = 0;
+    
+    	for (int w = 0; w < workers_count; w++) {
+    		n += wcontexts[w]->deadline_misses_count.load(std::memory_order_relaxed);
+    	}
+    
+    	return n;
+    }
+    
+    inline void reset_deadline_stats() {
+    	for (int w = 0; w < workers_count; w++) {
+    		wcontexts[w]->deadline_tasks_count.store(0, std::memory_order_relaxed);
+    		wcontexts[w]->deadline_misses_count.store(0, std::memory_order_relaxed);
+    	}
+    }
+    
+    // The tail of the deque of worker_id: its oldest task, the one thieves take.
+    inline task* take_oldest(const int worker_id) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	task* t = nullptr;
+    
+    	c->sync->lock();
+    
+    	if (c->head) {
+    		t = c->tail;
+    		c->tail = t->prev;
+    
+    		if (!c->tail) {
+    			c->head = nullptr;
+    
+    			clear_occupied(occupied_deques, worker_id);
+    		} else {
+    			c->tail->next = nullptr;
+    		}
     
     		t->prev = t->next = nullptr;
+    
+    		c->tasks_count.fetch_sub(1, std::memory_order_relaxed);
+    
+    		record_residency(worker_id, deque_queue, t);
     	}
     
     	c->sync->unlock();
@@ -253,57 +816,341 @@ namespace silk {
     	return t;
     }
     
+    //---------------------------------------------------------
+    // Fair polling. fetch_next prefers the run-next slot, mail and the LIFO
+    // end of the deque, so a worker busy with its own spawns never gets to
+    // its affinity queue (I/O completions) nor to the oldest tasks of its
+    // deque (enqueued from outside the pool). Every fair_poll_tasks fetches,
+    // and once fair_poll_us microseconds have passed since the last fair
+    // poll, the worker takes the oldest affinity task first, or else the
+    // oldest task of its deque. 0 turns a trigger off; both are off by
+    // default, so the LIFO order of a runtime is kept unless it asks for
+    // fairness, e.g. set_fairness(61).
+    //---------------------------------------------------------
+    int fair_poll_tasks = 0;
+    int fair_poll_us = 0;
+    
+    inline void set_fairness(const int every_tasks, const int every_us = 0) {
+    	fair_poll_tasks = every_tasks;
+    	fair_poll_us = every_us;
+    }
+    
+    inline bool is_fair_poll_due(wcontext* c) {
+    	bool is_due = fair_poll_tasks > 0 && ++c->fair_poll_count >= fair_poll_tasks;
+    
+    	if (fair_poll_us > 0) {
+    		const int64_t now = now_ns();
+    
+    		is_due = is_due || now - c->last_fair_poll_time >= int64_t(fair_poll_us) * 1000;
+    
+    		if (is_due) {
+    			c->last_fair_poll_time = now;
+    		}
+    	}
+    
+    	if (is_due) {
+    		c->fair_poll_count = 0;
+    	}
+    
+    	return is_due;
+    }
+    
+    inline task* fetch_affinity(const int worker_id);
+    
+    // The run-next task if any, then mail, then the head of the deque. After next_task_streak_limit run-next
+    // tasks in a row the others go first once, so tasks waking each other can not starve them. A fair poll,
+    // then the earliest deadline task, go before all of them.
+    inline task* fetch_next(const int worker_id) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	task* t;
+    
+    	if (is_fair_poll_due(c)) {
+    		t = fetch_affinity(worker_id);
+    
+    		if (!t) {
+    			t = take_oldest(worker_id);
+    		}
+    
+    		if (t)
+    			return t;
+    	}
+    
+    	if ((t = take_most_urgent(worker_id)))
+    		return t;
+    
+    	if (c->next_task_streak < next_task_streak_limit && (t = take_next_task(worker_id))) {
+    		c->next_task_streak++;
+    
+    		return t;
+    	}
+    
+    	c->next_task_streak = 0;
+    
+    	t = take_mail(worker_id, true);
+    
+    	if (!t) {
+    		t = fetch(worker_id);
+    	}
+    
+    	return t ? t : take_next_task(worker_id);
+    }
+    
     inline task* steal(const int thief_thread_id) {
     	task* t = nullptr;
     
     	wcontext* c = wcontexts[thief_thread_id];
     
+    	if ((t = steal_most_urgent(thief_thread_id)))
+    		return t;
+    
     	for (int i = 0; i < 100; i++) {
-    		int v = c->random->get() % workers_count;
+    		const int v = find_victim(thief_thread_id, c->random->get() % workers_count);
+    
+    		if (v < 0) {
+    			// nothing queued anywhere: let a random worker know a thief is hungry, it may split its work
+    			const int w = c->random->get() % workers_count;
     
-    		if (v == thief_thread_id)
-    			continue;
+    			if (w != thief_thread_id && !wcontexts[w]->is_thief_waiting.load(std::memory_order_relaxed))
+    				wcontexts[w]->is_thief_waiting.store(true, std::memory_order_relaxed);
+    
+    			break;
+    		}
     
     		wcontext* vc = wcontexts[v];
     
+    		t = take_oldest(v);
+    
+    		if (!t) {
+    			t = take_mail(v, false);
+    		}
+    
+    		if (!t && !vc->is_thief_waiting.load(std::memory_order_relaxed))
+    			vc->is_thief_waiting.store(true, std::memory_order_relaxed);
+    
+    		if (t)
+    			return t;
+    	}
+    
+    	// no queued task: take a run-next task its worker has not got to, it may be stuck behind a long task
+    	const int v = find_next_victim(thief_thread_id, c->random->get() % workers_count);
+    
+    	if (v >= 0 && !(t = take_next_task(v))) {
+    		// taken meanwhile, or a stale bit
+    		clear_next_occupied(v);
+    	}
+    
+    	return t;
+    }
+    
+    // Unlinks t from the deque of worker_id, the caller holds its lock.
+    inline void unlink(const int worker_id, task* t) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	if (t->prev) {
+    		t->prev->next = t->next;
+    	} else {
+    		c->head = t->next;
+    	}
+    
+    	if (t->next) {
+    		t->next->prev = t->prev;
+    	} else {
+    		c->tail = t->prev;
+    	}
+    
+    	if (!c->head) {
+    		clear_occupied(occupied_deques, worker_id);
+    	}
+    
+    	t->prev = t->next = nullptr;
+    
+    	c->tasks_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    
+    // Like fetch, but takes the newest task accept(t) lets through, skipping the others.
+    template<typename Accept> inline task* fetch_if(const int worker_id, Accept accept) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	if (c->tasks_count.load(std::memory_order_relaxed) == 0)
+    		return nullptr;
+    
+    	c->sync->lock();
+    
+    	task* t = c->head;
+    
+    	while (t && !accept(t)) {
+    		t = t->next;
+    	}
+    
+    	if (t) {
+    		unlink(worker_id, t);
+    
+    		record_residency(worker_id, deque_queue, t);
+    	}
+    
+    	c->sync->unlock();
+    
+    	return t;
+    }
+    
+    // Like steal, but takes the oldest task accept(t) lets through from the first victim that has one.
+    // Mailboxes and run-next slots are left alone.
+    template<typename Accept> inline task* steal_if(const int thief_thread_id, Accept accept) {
+    	wcontext* c = wcontexts[thief_thread_id];
+    
+    	const int start = c->random->get() % workers_count;
+    
+    	int v = find_victim(thief_thread_id, start);
+    
+    	for (int visited = 0; v >= 0 && visited < workers_count; visited++) {
+    		wcontext* vc = wcontexts[v];
+    
     		vc->sync->lock();
     
-    		if (vc->head) {
-    			t = vc->tail;
-    			vc->tail = t->prev;
+    		task* t = vc->tail;
     
-    			if (!vc->tail)
-    				vc->head = nullptr;
-    			else
-    				vc->tail->next = nullptr;
-    			
-    			t->prev = t->next = nullptr;
+    		while (t && !accept(t)) {
+    			t = t->prev;
+    		}
+    
+    		if (t) {
+    			unlink(v, t);
+    
+    			record_residency(v, deque_queue, t);
     		}
     
     		vc->sync->unlock();
     
     		if (t)
     			return t;
+    
+    		const int next = find_victim(thief_thread_id, (v + 1) % workers_count);
+    
+    		// back at (or past) the first victim
+    		if (next < 0 || (next - start + workers_count) % workers_count <= (v - start + workers_count) % workers_count)
+    			break;
+    
+    		v = next;
     	}
     
-    	return t;
+    	return nullptr;
+    }
+    
+    // Puts t at the FIFO end of the deque of worker_id (its tail), behind every task queued there.
+    inline void spawn_fifo(const int worker_id, task* t) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	t->prev = t->next = nullptr;
+    
+    	stamp(t);
+    
+    	c->sync->lock();
+    
+    	if (!c->tail) {
+    		c->tail = c->head = t;
+    
+    		set_occupied(occupied_deques, worker_id);
+    	} else {
+    		t->prev = c->tail;
+    		c->tail->next = t;
+    		c->tail = t;
+    	}
+    
+    	c->tasks_count.fetch_add(1, std::memory_order_relaxed);
+    
+    	c->sync->unlock();
+    
+    	sem->signal(workers_count);
+    }
+    
+    //---------------------------------------------------------
+    // Cooperative budget. A runtime refills the budget of the worker
+    // whenever it starts (resumes) a task, and every operation of the task
+    // that completes without suspending (a read with data ready, a channel
+    // value at hand) spends one unit. When the budget is spent the
+    // operation suspends the task anyway and spawn_fifo()s it, so a task
+    // that always finds its data ready can not keep a worker from the
+    // others. task_budget == 0 turns it off.
+    //---------------------------------------------------------
+    int task_budget = 128;
+    
+    inline void set_task_budget(const int operations) {
+    	task_budget = operations;
+    }
+    
+    inline void refill_budget(const int worker_id) {
+    	wcontexts[worker_id]->budget = task_budget;
+    }
+    
+    // Spends a unit of the budget of the running task; true when it is spent and the task has to yield.
+    inline bool spend_budget(const int worker_id) {
+    	if (task_budget <= 0)
+    		return false;
+    
+    	wcontext* c = wcontexts[worker_id];
+    
+    	// written by the worker only, the atomics are for the stats readers
+    	c->budget_spent_count.store(c->budget_spent_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    
+    	if (--c->budget > 0)
+    		return false;
+    
+    	c->budget = task_budget;
+    	c->budget_yields_count.store(c->budget_yields_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    
+    	return true;
+    }
+    
+    // Units of budget spent and yields forced by a spent budget, over all workers.
+    inline long budget_spent() {
+    	long n = 0;
+    
+    	for (int w = 0; w < workers_count; w++) {
+    		n += wcontexts[w]->budget_spent_count.load(std::memory_order_relaxed);
+    	}
+    
+    	return n;
+    }
+    
+    inline long budget_yields() {
+    	long n = 0;
+    
+    	for (int w = 0; w < workers_count; w++) {
+    		n += wcontexts[w]->budget_yields_count.load(std::memory_order_relaxed);
+    	}
+    
+    	return n;
+    }
+    
+    inline void reset_budget_stats() {
+    	for (int w = 0; w < workers_count; w++) {
+    		wcontexts[w]->budget_spent_count.store(0, std::memory_order_relaxed);
+    		wcontexts[w]->budget_yields_count.store(0, std::memory_order_relaxed);
+    	}
     }
     
     void enqueue( const int worker_id, task* t ) {
     	wcontext* c = wcontexts[worker_id];
     
     	t->prev = t->next = nullptr;
+    
+    	stamp(t);
     	
     	c->sync->lock();
     
     	if (!c->head) {
     		c->tail = c->head = t;
+    
+    		set_occupied(occupied_deques, worker_id);
     	} else {
     		t->next = c->head;
     		c->head->prev = t;
     		c->head = t;
     	}
     
+    	c->tasks_count.fetch_add(1, std::memory_order_relaxed);
+    
     	c->sync->unlock();
      
         sem->signal(workers_count);
@@ -314,6 +1161,8 @@ namespace silk {
     
     	t->prev = t->next = nullptr;
         
+    	stamp(t);
+    
     	c->affinity_sync->lock();
     
     	if (!c->affinity_head) {
@@ -333,6 +1182,8 @@ namespace silk {
     	wcontext* c = wcontexts[worker_id];
     
     	t->prev = t->next = nullptr;
+    
+    	stamp(t);
     	
     	c->affinity_sync->lock();
     
@@ -365,10 +1216,23 @@ namespace silk {
     			c->affinity_head = nullptr;
     		else 
     			c->affinity_tail->next = nullptr;
+    
+    		record_residency(worker_id, affinity_queue, t);
     	}
      
         c->affinity_sync->unlock();
      
         return t;
     }
+    
+    // True when the local deque is empty and a thief has come by and found nothing,
+    // i.e. splitting off more work now would actually be picked up by someone.
+    inline bool is_work_demanded(const int worker_id) {
+    	wcontext* c = wcontexts[worker_id];
+    
+    	if (c->tasks_count.load(std::memory_order_relaxed) != 0 || !c->is_thief_waiting.load(std::memory_order_relaxed))
+    		return false;
+    
+    	return c->is_thief_waiting.exchange(false, std::memory_order_relaxed);
+    }
 }
\ No newline at end of file
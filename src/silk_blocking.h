@@ -0,0 +1,177 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "./silk_pool.h"
+
+namespace silk {
+    //---------------------------------------------------------
+    // Elastic pool of threads for blocking calls (file I/O, DNS, legacy
+    // libraries), separate from the workers. A job gets an idle thread if
+    // there is one, otherwise a new thread is started, up to max_threads;
+    // beyond that jobs wait in FIFO order. A thread idle for keep_alive
+    // exits, so the pool shrinks back after a burst.
+    //---------------------------------------------------------
+    class blocking_pool {
+    	std::mutex sync_;
+    	std::condition_variable has_jobs_;
+    	std::deque<std::function<void()>> jobs_;
+    	int threads_count_ = 0;
+    	int idle_count_ = 0;
+    	const int max_threads_;
+    	const std::chrono::milliseconds keep_alive_;
+    
+    	void thread_loop() {
+    		std::unique_lock<std::mutex> l(sync_);
+    
+    		while (1) {
+    			if (!jobs_.empty()) {
+    				std::function<void()> job = std::move(jobs_.front());
+    				jobs_.pop_front();
+    
+    				l.unlock();
+    
+    				job();
+    
+    				l.lock();
+    
+    				continue;
+    			}
+    
+    			idle_count_++;
+    
+    			const bool has_jobs = has_jobs_.wait_for(l, keep_alive_, [this]() { return !jobs_.empty(); });
+    
+    			idle_count_--;
+    
+    			if (!has_jobs) {
+    				threads_count_--;
+    
+    				return;
+    			}
+    		}
+    	}
+    public:
+    	blocking_pool(const int max_threads = 512, const std::chrono::milliseconds keep_alive = std::chrono::milliseconds(10000)) :
+    		max_threads_(max_threads), keep_alive_(keep_alive) {
+    	}
+    
+    	blocking_pool(const blocking_pool&) = delete;
+    
+    	void submit(std::function<void()> job) {
+    		std::unique_lock<std::mutex> l(sync_);
+    
+    		jobs_.push_back(std::move(job));
+    
+    		const bool is_starting = idle_count_ < (int) jobs_.size() && threads_count_ < max_threads_;
+    
+    		if (is_starting) {
+    			threads_count_++;
+    		}
+    
+    		l.unlock();
+    
+    		if (is_starting) {
+    			std::thread t([this]() { thread_loop(); });
+    			t.detach();
+    		} else {
+    			has_jobs_.notify_one();
+    		}
+    	}
+    
+    	int threads_count() {
+    		std::lock_guard<std::mutex> l(sync_);
+    		return threads_count_;
+    	}
+    };
+    
+    blocking_pool* blocking_threads = new blocking_pool();
+    
+    // Runs fn on a thread of the blocking pool, never on a worker.
+    inline void run_blocking(std::function<void()> fn) {
+    	blocking_threads->submit(std::move(fn));
+    }
+    
+    thread_local int blocking_region_depth;
+    
+    //---------------------------------------------------------
+    // Marks a blocking call made on a worker:
+    //     { silk::blocking_region r; fsync(fd); }
+    // For the duration a thread of the blocking pool stands in for the
+    // worker: it takes the worker id and runs its deque, mailbox and
+    // run-next slot (and steals) while the worker thread is blocked.
+    // Leaving the region waits until the stand-in has finished the task it
+    // is running and hands the worker id back. Nested regions and regions
+    // outside the workers do nothing.
+    //---------------------------------------------------------
+    class blocking_region {
+    	struct compensation {
+    		std::atomic<bool> is_stopped;
+    		std::atomic<bool> is_done;
+    	};
+    
+    	compensation* c_ = nullptr;
+    	bool is_entered_ = false;
+    
+    	static void compensate(const int worker_id, compensation* c) {
+    		current_worker_id = worker_id;
+    		is_worker_thread = true;
+    
+    		join_pool_while(pool_schedule, [c]() { return !c->is_stopped.load(std::memory_order_acquire); });
+    
+    		is_worker_thread = false;
+    
+    		c->is_done.store(true, std::memory_order_release);
+    	}
+    public:
+    	blocking_region() {
+    		if (!is_worker_thread)
+    			return;
+    
+    		is_entered_ = true;
+    
+    		if (blocking_region_depth++ > 0)
+    			return;
+    
+    		c_ = new compensation();
+    		c_->is_stopped.store(false, std::memory_order_relaxed);
+    		c_->is_done.store(false, std::memory_order_relaxed);
+    
+    		const int worker_id = current_worker_id;
+    		compensation* c = c_;
+    
+    		blocking_threads->submit([worker_id, c]() { compensate(worker_id, c); });
+    	}
+    
+    	blocking_region(const blocking_region&) = delete;
+    
+    	// ends the region before the destructor, e.g. to restore runtime state of the worker afterwards
+    	void leave() {
+    		if (!is_entered_)
+    			return;
+    
+    		is_entered_ = false;
+    
+    		if (--blocking_region_depth > 0)
+    			return;
+    
+    		c_->is_stopped.store(true, std::memory_order_release);
+    
+    		while (!c_->is_done.load(std::memory_order_acquire)) {
+    			std::this_thread::yield();
+    		}
+    
+    		delete c_;
+    		c_ = nullptr;
+    	}
+    
+    	~blocking_region() {
+    		leave();
+    	}
+    };
+}
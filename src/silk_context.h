@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#if defined(__APPLE__)
+#define SILK_ASM_SYMBOL(name) "_" #name
+#else
+#define SILK_ASM_SYMBOL(name) #name
+#endif
+
+#if defined(__ELF__)
+#define SILK_ASM_FUNCTION(name) ".globl " SILK_ASM_SYMBOL(name) "\n.type " SILK_ASM_SYMBOL(name) ",%function\n.p2align 4\n" SILK_ASM_SYMBOL(name) ":\n"
+#else
+#define SILK_ASM_FUNCTION(name) ".globl " SILK_ASM_SYMBOL(name) "\n.p2align 4\n" SILK_ASM_SYMBOL(name) ":\n"
+#endif
+
+//---------------------------------------------------------
+// Cooperative context switch. Only callee-saved registers are
+// kept, there is no signal mask, so a switch is a few dozen
+// instructions instead of the rt_sigprocmask syscall swapcontext does.
+//---------------------------------------------------------
+#if defined(__x86_64__)
+__asm__(
+	".text\n"
+	SILK_ASM_FUNCTION(silk_swap_coro_context)
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq (%rsi), %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	SILK_ASM_FUNCTION(silk_coro_context_trampoline)
+	"	movq (%r13), %rdi\n"
+	"	movq 8(%r13), %rsi\n"
+	"	movq 16(%r13), %rdx\n"
+	"	movq 24(%r13), %rcx\n"
+	"	movq 32(%r13), %r8\n"
+	"	movq 40(%r13), %r9\n"
+	"	callq *%r12\n"
+	"	movq %r15, %rdi\n"
+	"	movq 8(%r15), %rsi\n"
+	"	callq " SILK_ASM_SYMBOL(silk_swap_coro_context) "\n"
+	"	ud2\n"
+);
+#elif defined(__aarch64__)
+__asm__(
+	".text\n"
+	SILK_ASM_FUNCTION(silk_swap_coro_context)
+	"	sub sp, sp, #160\n"
+	"	stp x19, x20, [sp, #0]\n"
+	"	stp x21, x22, [sp, #16]\n"
+	"	stp x23, x24, [sp, #32]\n"
+	"	stp x25, x26, [sp, #48]\n"
+	"	stp x27, x28, [sp, #64]\n"
+	"	stp x29, x30, [sp, #80]\n"
+	"	stp d8, d9, [sp, #96]\n"
+	"	stp d10, d11, [sp, #112]\n"
+	"	stp d12, d13, [sp, #128]\n"
+	"	stp d14, d15, [sp, #144]\n"
+	"	mov x9, sp\n"
+	"	str x9, [x0]\n"
+	"	ldr x9, [x1]\n"
+	"	mov sp, x9\n"
+	"	ldp x19, x20, [sp, #0]\n"
+	"	ldp x21, x22, [sp, #16]\n"
+	"	ldp x23, x24, [sp, #32]\n"
+	"	ldp x25, x26, [sp, #48]\n"
+	"	ldp x27, x28, [sp, #64]\n"
+	"	ldp x29, x30, [sp, #80]\n"
+	"	ldp d8, d9, [sp, #96]\n"
+	"	ldp d10, d11, [sp, #112]\n"
+	"	ldp d12, d13, [sp, #128]\n"
+	"	ldp d14, d15, [sp, #144]\n"
+	"	add sp, sp, #160\n"
+	"	ret\n"
+	SILK_ASM_FUNCTION(silk_coro_context_trampoline)
+	"	ldp x0, x1, [x20, #0]\n"
+	"	ldp x2, x3, [x20, #16]\n"
+	"	ldp x4, x5, [x20, #32]\n"
+	"	blr x19\n"
+	"	mov x0, x21\n"
+	"	ldr x1, [x21, #8]\n"
+	"	bl " SILK_ASM_SYMBOL(silk_swap_coro_context) "\n"
+	"	brk #0\n"
+);
+#else
+#error Unsupported platform!
+#endif
+
+namespace silk {
+    struct coro_context {
+    	void* sp;
+    	coro_context* link; // context to switch to when the entry function returns (like uc_link)
+    };
+}
+
+extern "C" void silk_swap_coro_context(silk::coro_context* from, silk::coro_context* to);
+extern "C" void silk_coro_context_trampoline();
+
+namespace silk {
+    inline void swap_coro_context(coro_context* from, coro_context* to) {
+    	silk_swap_coro_context(from, to);
+    }
+    
+    // Same contract as makecontext: func gets up to 6 integer/pointer arguments.
+    template<typename... Args> void make_coro_context(coro_context* c, void(*func)(), char* stack, const size_t stack_size, const int args_size, Args... args) {
+    	static_assert(sizeof...(Args) <= 6, "make_coro_context supports up to 6 arguments");
+    	assert(args_size == (int) sizeof...(Args));
+    
+    	uintptr_t* argv = (uintptr_t*) (((uintptr_t) stack + stack_size - 6 * sizeof(uintptr_t)) & ~(uintptr_t) 15);
+    	uintptr_t values[] = { (uintptr_t) args..., 0 };
+    
+    	for (int i = 0; i < 6; i++) {
+    		argv[i] = i < (int) sizeof...(Args) ? values[i] : 0;
+    	}
+    
+    	c->link = nullptr;
+    
+    #if defined(__x86_64__)
+    	uintptr_t* sp = argv - 8;
+    	((uint32_t*) sp)[0] = 0x1F80; // mxcsr
+    	((uint16_t*) sp)[2] = 0x037F; // x87 control word
+    	sp[1] = (uintptr_t) c; // r15
+    	sp[2] = 0; // r14
+    	sp[3] = (uintptr_t) argv; // r13
+    	sp[4] = (uintptr_t) func; // r12
+    	sp[5] = 0; // rbx
+    	sp[6] = 0; // rbp
+    	sp[7] = (uintptr_t) silk_coro_context_trampoline;
+    #elif defined(__aarch64__)
+    	uintptr_t* sp = argv - 20;
+    	for (int i = 0; i < 20; i++) {
+    		sp[i] = 0;
+    	}
+    	sp[0] = (uintptr_t) func; // x19
+    	sp[1] = (uintptr_t) argv; // x20
+    	sp[2] = (uintptr_t) c; // x21
+    	sp[11] = (uintptr_t) silk_coro_context_trampoline; // x30
+    #endif
+    
+    	c->sp = sp;
+    }
+}
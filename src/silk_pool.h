@@ -6,13 +6,42 @@
 
 namespace silk {
     thread_local int current_worker_id;
+    thread_local bool is_worker_thread;
+    // true while the thread runs one of the pool loops below, so it drains its own run-next slot
+    thread_local bool is_in_pool_loop;
     std::atomic<int> workers_count_incrementor;
     
+    // schedule func of the pool, for threads that stand in for a worker (silk_blocking.h)
+    void(*pool_schedule)(task*);
+    
     inline void init_wcontext(wcontext* c) {
     	c->head = c->tail = c->affinity_head = c->affinity_tail = nullptr;
     	c->random = new fast_random(c);
     	c->sync = new spin_lock();
     	c->affinity_sync = new spin_lock();
+    	c->tasks_count.store(0, std::memory_order_relaxed);
+    	c->is_thief_waiting.store(false, std::memory_order_relaxed);
+    	c->next_task.store(nullptr, std::memory_order_relaxed);
+    	c->next_task_streak = 0;
+    	c->mailbox_head = c->mailbox_tail = nullptr;
+    	c->mailbox_sync = new spin_lock();
+    	c->mailbox_count.store(0, std::memory_order_relaxed);
+    	c->inline_depth = 0;
+    	c->fair_poll_count = 0;
+    	c->last_fair_poll_time = now_ns();
+    	c->deadline_sync = new spin_lock();
+    	c->deadline_heap = nullptr;
+    	c->earliest_deadline.store(INT64_MAX, std::memory_order_relaxed);
+    	c->deadline_tasks_count.store(0, std::memory_order_relaxed);
+    	c->deadline_misses_count.store(0, std::memory_order_relaxed);
+    	c->budget = task_budget;
+    	c->budget_spent_count.store(0, std::memory_order_relaxed);
+    	c->budget_yields_count.store(0, std::memory_order_relaxed);
+    #if defined(SILK_QUEUE_STATS)
+    	for (int q = 0; q < queue_kinds_count; q++) {
+    		c->max_residency[q].store(0, std::memory_order_relaxed);
+    	}
+    #endif
     }
     
     wcontext* makecontext() {
@@ -26,12 +55,14 @@ namespace silk {
     
     	int worker_id = current_worker_id;
     
+    	is_in_pool_loop = true;
+    
     	sem->wait();
     
     	std::atomic_thread_fence(std::memory_order_acquire);
     
     	while (1) {
-    		task* t = fetch(worker_id);
+    		task* t = fetch_next(worker_id);
     
     		if (!t) {
     			t = fetch_affinity(worker_id);
@@ -45,12 +76,15 @@ namespace silk {
     			wait_count = 0;
     			s(t);
     		} else {
-    			if (wait_count < 200) {
+    			// spin only after a lost race for a queued task, with nothing queued anywhere park at once
+    			if (wait_count < 200 && is_any_occupied()) {
     				wait_count++;
     
     				continue;
     			}
     
+    			wait_count = 0;
+    
     			sem->wait();
     		}
     	}
@@ -61,8 +95,11 @@ namespace silk {
     
     	int worker_id = current_worker_id;
     
+    	const bool was_in_pool_loop = is_in_pool_loop;
+    	is_in_pool_loop = true;
+    
     	while (1) {
-    		task* t = fetch(worker_id);
+    		task* t = fetch_next(worker_id);
     
     		if (!t) {
     			t = fetch_affinity(worker_id);
@@ -82,17 +119,74 @@ namespace silk {
     				continue;
     			}
     
+    			is_in_pool_loop = was_in_pool_loop;
+    
     			return;
     		}
     	}
     }
     
+    // Executes pool tasks on the current thread while is_pending() returns true.
+    template<typename Predicate> inline void join_pool_while(void(*s)(task*), Predicate is_pending) {
+    	int worker_id = current_worker_id;
+    
+    	const bool was_in_pool_loop = is_in_pool_loop;
+    	is_in_pool_loop = true;
+    
+    	while (is_pending()) {
+    		task* t = fetch_next(worker_id);
+    
+    		if (!t) {
+    			t = fetch_affinity(worker_id);
+    		}
+    
+    		if (!t) {
+    			t = steal(worker_id);
+    		}
+    
+    		if (t) {
+    			s(t);
+    		} else {
+    			std::this_thread::yield();
+    		}
+    	}
+    
+    	is_in_pool_loop = was_in_pool_loop;
+    }
+    
+    // join_pool_while that executes only tasks accept(t) lets through: from the own deque first, then stolen.
+    // Other tasks stay where they are, so a long unrelated task can not end up on the stack of the waiter.
+    template<typename Predicate, typename Accept> inline void join_pool_while_accepting(void(*s)(task*), Predicate is_pending, Accept accept) {
+    	int worker_id = current_worker_id;
+    
+    	// the run-next slot is not drained here, woken tasks go to the deque
+    	const bool was_in_pool_loop = is_in_pool_loop;
+    	is_in_pool_loop = false;
+    
+    	while (is_pending()) {
+    		task* t = fetch_if(worker_id, accept);
+    
+    		if (!t) {
+    			t = steal_if(worker_id, accept);
+    		}
+    
+    		if (t) {
+    			s(t);
+    		} else {
+    			std::this_thread::yield();
+    		}
+    	}
+    
+    	is_in_pool_loop = was_in_pool_loop;
+    }
+    
     inline void join_main_thread_2_pool_in_infinity_loop(void(*s)(task*)) {
     	schedule_loop(s);
     }
     
     void start_schedule_loop_4_not_main_thread(void(*s)(task*)) {
     	current_worker_id = workers_count_incrementor.fetch_add(1, std::memory_order_acquire);
+    	is_worker_thread = true;
     
     	schedule_loop(s);
     }
@@ -101,10 +195,18 @@ namespace silk {
     	wcontexts = (wcontext**) malloc(threads * sizeof(wcontext*));
     
     	workers_count = threads;
+    	pool_schedule = s;
+    
+    	occupancy_words_count = (threads + 63) / 64;
+    	occupied_deques = new std::atomic<uint64_t>[occupancy_words_count]();
+    	occupied_mailboxes = new std::atomic<uint64_t>[occupancy_words_count]();
+    	occupied_deadlines = new std::atomic<uint64_t>[occupancy_words_count]();
+    	occupied_next = new std::atomic<uint64_t>[occupancy_words_count]();
     
     	wcontexts[0] = mc();
     
     	current_worker_id = workers_count_incrementor.fetch_add(1, std::memory_order_acquire);
+    	is_worker_thread = true;
     
     	for (int i = 1; i < threads; i++) {
     		std::thread w(start_schedule_loop_4_not_main_thread, s);
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(MAP_NORESERVE)
+#define SILK_STACK_MAP_FLAGS (MAP_PRIVATE | MAP_ANON | MAP_NORESERVE)
+#else
+#define SILK_STACK_MAP_FLAGS (MAP_PRIVATE | MAP_ANON)
+#endif
+
+#if defined(__linux__)
+#define SILK_STACK_TRIM_ADVICE MADV_DONTNEED
+#else
+#define SILK_STACK_TRIM_ADVICE MADV_FREE
+#endif
+
+namespace silk {
+    //---------------------------------------------------------
+    // Stacks for stackful coroutines: mmap'd, lazily committed, with a
+    // PROT_NONE guard page below the usable area. Freed stacks are
+    // cached per worker by size class; the first hot_stacks of a class
+    // stay resident, the rest give their pages back with madvise. A stack
+    // goes back to the pool that allocated it: freed on another worker it
+    // is pushed to the returned list of its owner, which takes the whole
+    // list back once a size class runs dry.
+    //---------------------------------------------------------
+    const int stack_size_classes = 4;
+    const size_t stack_class_sizes[stack_size_classes] = { 16 * 1024, 32 * 1024, 128 * 1024, 1024 * 1024 };
+    const int hot_stacks = 16;
+    const int max_cached_stacks = 1024;
+    
+    struct stack_pool;
+    
+    struct stack {
+    	stack* next;
+    	char* base;
+    	size_t size;
+    	int size_class;
+    	stack_pool* owner;
+    };
+    
+    struct stack_pool {
+    	stack* free_stacks[stack_size_classes];
+    	int free_count[stack_size_classes];
+    	std::atomic<stack*> returned;
+    };
+    
+    inline size_t page_size() {
+    	static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    	return size;
+    }
+    
+    inline stack_pool* make_stack_pool() {
+    	stack_pool* p = new stack_pool();
+    
+    	for (int i = 0; i < stack_size_classes; i++) {
+    		p->free_stacks[i] = nullptr;
+    		p->free_count[i] = 0;
+    	}
+    
+    	p->returned.store(nullptr, std::memory_order_relaxed);
+    
+    	return p;
+    }
+    
+    inline stack* map_stack(const size_t size, const int size_class) {
+    	const size_t guard = page_size();
+    	const size_t usable = (size + guard - 1) & ~(guard - 1);
+    
+    	char* m = (char*) mmap(nullptr, usable + guard, PROT_READ | PROT_WRITE, SILK_STACK_MAP_FLAGS, -1, 0);
+    
+    	if (m == MAP_FAILED)
+    		return nullptr;
+    
+    	mprotect(m, guard, PROT_NONE);
+    
+    	stack* s = new stack();
+    	s->next = nullptr;
+    	s->base = m + guard;
+    	s->size = usable;
+    	s->size_class = size_class;
+    	s->owner = nullptr;
+    
+    	return s;
+    }
+    
+    inline void unmap_stack(stack* s) {
+    	munmap(s->base - page_size(), s->size + page_size());
+    
+    	delete s;
+    }
+    
+    // Puts a free stack of p into its cache, on the thread of p.
+    inline void cache_stack(stack_pool* p, stack* s) {
+    	const int c = s->size_class;
+    
+    	if (c < 0 || p->free_count[c] >= max_cached_stacks) {
+    		unmap_stack(s);
+    
+    		return;
+    	}
+    
+    	if (p->free_count[c] >= hot_stacks) {
+    		// keep the top page, it is touched again by the next coroutine anyway
+    		madvise(s->base, s->size - page_size(), SILK_STACK_TRIM_ADVICE);
+    	}
+    
+    	s->next = p->free_stacks[c];
+    	p->free_stacks[c] = s;
+    	p->free_count[c]++;
+    }
+    
+    // Takes back the stacks of p freed on other workers.
+    inline void take_returned_stacks(stack_pool* p) {
+    	if (!p->returned.load(std::memory_order_relaxed))
+    		return;
+    
+    	stack* s = p->returned.exchange(nullptr, std::memory_order_acquire);
+    
+    	while (s) {
+    		stack* next = s->next;
+    
+    		cache_stack(p, s);
+    
+    		s = next;
+    	}
+    }
+    
+    inline stack* allocate_stack(stack_pool* p, const size_t size) {
+    	int c = 0;
+    
+    	while (c < stack_size_classes && stack_class_sizes[c] < size) {
+    		c++;
+    	}
+    
+    	if (c == stack_size_classes)
+    		return map_stack(size, -1);
+    
+    	if (!p->free_stacks[c]) {
+    		take_returned_stacks(p);
+    	}
+    
+    	stack* s = p->free_stacks[c];
+    
+    	if (!s) {
+    		s = map_stack(stack_class_sizes[c], c);
+    
+    		if (s) {
+    			s->owner = p;
+    		}
+    
+    		return s;
+    	}
+    
+    	p->free_stacks[c] = s->next;
+    	p->free_count[c]--;
+    
+    	s->next = nullptr;
+    
+    	return s;
+    }
+    
+    // p is the pool of the current worker.
+    inline void free_stack(stack_pool* p, stack* s) {
+    	if (s->size_class < 0) {
+    		unmap_stack(s);
+    
+    		return;
+    	}
+    
+    	if (s->owner == p) {
+    		cache_stack(p, s);
+    
+    		return;
+    	}
+    
+    	stack_pool* owner = s->owner;
+    
+    	stack* head = owner->returned.load(std::memory_order_relaxed);
+    
+    	do {
+    		s->next = head;
+    	} while (!owner->returned.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+    }
+}